@@ -0,0 +1,72 @@
+/*
+ * regame: recycling game - heap allocation counting
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "alloc.hh"
+
+#ifdef COUNT_ALLOCS
+#include <atomic>
+#include <new>
+
+#include <stdlib.h>
+#endif
+
+
+/*
+ * Implementation
+ */
+
+#ifdef COUNT_ALLOCS
+
+namespace
+{
+  std::atomic<long> count(0);
+}
+
+
+// the array and nothrow forms end up here too
+void*
+operator new(size_t size)
+{
+  count.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(size? size: 1);
+  if(!p) throw std::bad_alloc();
+  return p;
+}
+
+
+void
+operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+
+void
+operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+
+long
+allocations()
+{
+  return count.load(std::memory_order_relaxed);
+}
+
+#else
+
+long
+allocations()
+{
+  return -1;
+}
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * regame: recycling game - heap allocation counting
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef alloc_hh
+#define alloc_hh
+
+// calls to operator new so far, on all threads: -1 unless built with
+// COUNT_ALLOCS ("make COUNT_ALLOCS=1")
+long
+allocations();
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * regame: recycling game - level arena
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "arena.hh"
+
+#include <stdlib.h>
+
+
+/*
+ * Constants
+ */
+
+namespace
+{
+  const size_t align = 16;
+}
+
+
+/*
+ * Implementation
+ */
+
+void*
+Arena::alloc(size_t n)
+{
+  n = (n + align - 1) & ~(align - 1);
+
+  std::lock_guard<std::mutex> guard(lock);
+  if(static_cast<size_t>(end - cur) < n)
+  {
+    // big buffers (decoded images) get a block of their own, without
+    // wasting what's left of the current one
+    size_t hdr = (sizeof(Block) + align - 1) & ~(align - 1);
+    size_t size = hdr + (n > blockSize / 4? n: static_cast<size_t>(blockSize));
+    Block* b = static_cast<Block*>(malloc(size));
+    if(!b) throw std::bad_alloc();
+    b->size = size;
+    total += size;
+
+    char* p = reinterpret_cast<char*>(b) + hdr;
+    if(n > blockSize / 4 && blocks)
+    {
+      // behind the current block
+      b->next = blocks->next;
+      blocks->next = b;
+      used += n;
+      return p;
+    }
+    b->next = blocks;
+    blocks = b;
+    cur = p;
+    end = reinterpret_cast<char*>(b) + size;
+  }
+
+  void* p = cur;
+  cur += n;
+  used += n;
+  return p;
+}
+
+
+void
+Arena::release()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  while(blocks)
+  {
+    Block* b = blocks;
+    blocks = b->next;
+    free(b);
+  }
+  cur = end = NULL;
+  used = total = 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * regame: recycling game - level arena
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef arena_hh
+#define arena_hh
+
+/*
+ * Headers
+ */
+
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+#include <stddef.h>
+
+
+/*
+ * Bump allocator for data living as long as a level: allocations are carved
+ * out of big blocks and never freed one by one, but all at once by release()
+ * (or the destructor). Allocating is serialized, so that the decoders can
+ * share an arena.
+ */
+
+class Arena
+{
+  struct Block
+  {
+    Block* next;
+    size_t size;
+  };
+
+  std::mutex lock;
+  Block* blocks;	// most recent first
+  char* cur;
+  char* end;
+  size_t used;
+  size_t total;
+
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+public:
+  enum { blockSize = 256 * 1024 };
+
+  Arena()
+  : blocks(NULL), cur(NULL), end(NULL), used(0), total(0)
+  {}
+
+  ~Arena()
+  { release(); }
+
+  // n bytes aligned for anything: throws bad_alloc
+  void* alloc(size_t n);
+
+  // everything at once
+  void release();
+
+  // bytes handed out, and held in blocks
+  size_t size() const
+  { return used; }
+
+  size_t capacity() const
+  { return total; }
+};
+
+
+/*
+ * Standard allocator over an arena, or the heap without one. Copies of a
+ * container go to the heap: an arena only holds the level's own data, and
+ * nothing else has to care about its lifetime.
+ */
+
+template<class T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+  typedef std::false_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  Arena* arena;
+
+  ArenaAllocator(Arena* arena = NULL)
+  : arena(arena)
+  {}
+
+  template<class U>
+  ArenaAllocator(const ArenaAllocator<U>& a)
+  : arena(a.arena)
+  {}
+
+  T* allocate(size_t n)
+  {
+    return static_cast<T*>(arena? arena->alloc(n * sizeof(T)):
+	::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t)
+  { if(!arena) ::operator delete(p); }
+
+  ArenaAllocator select_on_container_copy_construction() const
+  { return ArenaAllocator(); }
+
+  template<class U>
+  bool operator==(const ArenaAllocator<U>& a) const
+  { return arena == a.arena; }
+
+  template<class U>
+  bool operator!=(const ArenaAllocator<U>& a) const
+  { return arena != a.arena; }
+};
+
+#endif
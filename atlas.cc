@@ -0,0 +1,166 @@
+/*
+ * regame: recycling game - texture atlas packing
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "atlas.hh"
+
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+
+
+/*
+ * Utilities
+ */
+
+namespace
+{
+  struct ByHeight
+  {
+    const vector<const Image*>& imgs;
+
+    ByHeight(const vector<const Image*>& imgs)
+    : imgs(imgs)
+    {}
+
+    bool operator()(size_t a, size_t b) const
+    { return imgs[a]->h > imgs[b]->h; }
+  };
+
+
+  void
+  blit(Image& page, const Image& img, int px, int py, int pad)
+  {
+    const int chans = 4;
+    unsigned char* base = &page.px[0];
+    int stride = page.w * chans;
+
+    // copy and replicate the left/right edges
+    for(int y = 0; y != img.h; ++y)
+    {
+      unsigned char* dst = base + (py + y) * stride + px * chans;
+      const unsigned char* src = &img.px[y * img.w * chans];
+      memcpy(dst, src, img.w * chans);
+      for(int x = 1; x <= pad; ++x)
+      {
+	memcpy(dst - x * chans, src, chans);
+	memcpy(dst + (img.w - 1 + x) * chans, src + (img.w - 1) * chans, chans);
+      }
+    }
+
+    // replicate the top/bottom rows, including the corners
+    int len = (img.w + pad * 2) * chans;
+    unsigned char* first = base + py * stride + (px - pad) * chans;
+    unsigned char* last = first + (img.h - 1) * stride;
+    for(int y = 1; y <= pad; ++y)
+    {
+      memcpy(first - y * stride, first, len);
+      memcpy(last + y * stride, last, len);
+    }
+  }
+}
+
+
+bool
+packAtlas(vector<Image>& pages, vector<AtlasRect>& rects,
+    const vector<const Image*>& imgs, int maxSize, int pad, bool pow2)
+{
+  pages.clear();
+  rects.resize(imgs.size());
+  if(!imgs.size()) return false;
+
+  // tallest first on shelves
+  vector<size_t> order(imgs.size());
+  long area = 0;
+  int width = 0;
+  for(size_t i = 0; i != imgs.size(); ++i)
+  {
+    order[i] = i;
+    area += (imgs[i]->w + pad * 2) * (imgs[i]->h + pad * 2);
+    width = std::max(width, imgs[i]->w + pad * 2);
+  }
+  std::stable_sort(order.begin(), order.end(), ByHeight(imgs));
+
+  // aim for a square-ish page
+  width = std::max(width, static_cast<int>(ceil(sqrt(area))));
+  if(pow2) width = nextPower(width);
+  width = std::min(width, maxSize);
+
+  // place on shelves, opening new pages as needed
+  vector<int> heights;
+  int page = 0, x = 0, y = 0, shelf = 0;
+  heights.push_back(0);
+  for(size_t n = 0; n != order.size(); ++n)
+  {
+    const Image& img = *imgs[order[n]];
+    int w = img.w + pad * 2;
+    int h = img.h + pad * 2;
+    if(w > width || h > maxSize) return true;
+
+    if(x + w > width)
+    {
+      // next shelf
+      y += shelf;
+      x = shelf = 0;
+    }
+    if(y + h > maxSize)
+    {
+      // next page
+      heights.push_back(0);
+      ++page;
+      x = y = shelf = 0;
+    }
+
+    rects[order[n]].page = page;
+    rects[order[n]].x = x + pad;
+    rects[order[n]].y = y + pad;
+    rects[order[n]].w = img.w;
+    rects[order[n]].h = img.h;
+    x += w;
+    shelf = std::max(shelf, h);
+    heights[page] = std::max(heights[page], y + h);
+  }
+
+  // compose the pages
+  pages.resize(heights.size());
+  for(size_t p = 0; p != pages.size(); ++p)
+  {
+    pages[p].w = width;
+    pages[p].h = (pow2? nextPower(heights[p]): heights[p]);
+    pages[p].chans = 4;
+    pages[p].px.assign(pages[p].w * pages[p].h * pages[p].chans, 0);
+  }
+  for(size_t i = 0; i != imgs.size(); ++i)
+    if(imgs[i]->w && imgs[i]->h)
+      blit(pages[rects[i].page], *imgs[i], rects[i].x, rects[i].y, pad);
+
+  return false;
+}
+
+
+void
+assignAtlas(const vector<Sprite*>& sprites, const vector<Sprite>& pages,
+    const vector<AtlasRect>& rects)
+{
+  for(size_t i = 0; i != sprites.size(); ++i)
+  {
+    const Sprite& page = pages[rects[i].page];
+    float su = page.u1 / page.w;
+    float sv = page.v1 / page.h;
+
+    Sprite& s = *sprites[i];
+    s.tex = page.tex;
+    s.w = rects[i].w;
+    s.h = rects[i].h;
+    s.u0 = rects[i].x * su;
+    s.v0 = rects[i].y * sv;
+    s.u1 = (rects[i].x + s.w) * su;
+    s.v1 = (rects[i].y + s.h) * sv;
+  }
+}
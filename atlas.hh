@@ -0,0 +1,58 @@
+/*
+ * regame: recycling game - texture atlas packing
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef atlas_hh
+#define atlas_hh
+
+/*
+ * Headers
+ */
+
+#include "image.hh"
+#include "world.hh"
+
+
+/*
+ * Constants
+ */
+
+// edge pixels around each sprite, and page size for offline packing
+const int atlasPad = 2;
+const int atlasPackSize = 2048;
+
+
+/*
+ * Structures
+ */
+
+// location of an image inside the atlas
+struct AtlasRect
+{
+  int page;
+  int x, y;
+  int w, h;
+};
+
+
+/*
+ * Utilities
+ */
+
+// Pack RGBA images into as few pages as possible, each at most maxSize
+// pixels wide/tall. Every image gets pad pixels of replicated edge around it
+// to prevent bleeding with linear filtering. Returns true if an image does
+// not fit in a page at all.
+bool
+packAtlas(vector<Image>& pages, vector<AtlasRect>& rects,
+    const vector<const Image*>& imgs, int maxSize, int pad, bool pow2);
+
+// point the sprites to their sub-rectangles, in texels or normalized as the
+// page is
+void
+assignAtlas(const vector<Sprite*>& sprites, const vector<Sprite>& pages,
+    const vector<AtlasRect>& rects);
+
+#endif
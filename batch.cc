@@ -0,0 +1,111 @@
+/*
+ * regame: recycling game - sprite batching
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "batch.hh"
+
+#include <math.h>
+
+
+/*
+ * Utilities
+ */
+
+namespace
+{
+  inline unsigned char
+  toByte(float v)
+  {
+    return static_cast<unsigned char>(
+	(v <= 0? 0: (v >= 1? 255: v * 255. + 0.5)));
+  }
+}
+
+
+
+/*
+ * Implementation
+ */
+
+Affine
+Affine::rotate(double deg)
+{
+  double rad = deg * M_PI / 180.;
+  float cs = cos(rad);
+  float sn = sin(rad);
+  return Affine(cs, sn, -sn, cs, 0, 0);
+}
+
+
+void
+SpriteBatch::add(const Sprite& s, const Affine& m, const Point2f& p,
+    float r, float g, float b, float a)
+{
+  if(!runs.size() || runs.back().tex != s.tex)
+  {
+    Run run;
+    run.tex = s.tex;
+    run.first = verts.size();
+    run.count = 0;
+    runs.push_back(run);
+  }
+
+  // image rows are stored top first
+  const float qx[4] = {p.x, p.x + s.w, p.x + s.w, p.x};
+  const float qy[4] = {p.y, p.y, p.y + s.h, p.y + s.h};
+  const float qu[4] = {s.u0, s.u1, s.u1, s.u0};
+  const float qv[4] = {s.v1, s.v1, s.v0, s.v0};
+
+  Vertex v;
+  v.color[0] = toByte(r);
+  v.color[1] = toByte(g);
+  v.color[2] = toByte(b);
+  v.color[3] = toByte(a);
+  for(int i = 0; i != 4; ++i)
+  {
+    v.x = m.a * qx[i] + m.c * qy[i] + m.tx;
+    v.y = m.b * qx[i] + m.d * qy[i] + m.ty;
+    v.u = qu[i];
+    v.v = qv[i];
+    verts.push_back(v);
+  }
+
+  runs.back().count += 4;
+}
+
+
+void
+SpriteBatch::add(const SpriteBatch& src, float x, float y,
+    float r, float g, float b, float a)
+{
+  unsigned char color[4] = {toByte(r), toByte(g), toByte(b), toByte(a)};
+  for(size_t n = 0; n != src.runs.size(); ++n)
+  {
+    const Run& from = src.runs[n];
+    if(!runs.size() || runs.back().tex != from.tex)
+    {
+      Run run;
+      run.tex = from.tex;
+      run.first = verts.size();
+      run.count = 0;
+      runs.push_back(run);
+    }
+
+    for(size_t i = from.first; i != from.first + from.count; ++i)
+    {
+      Vertex v = src.verts[i];
+      v.x += x;
+      v.y += y;
+      for(int c = 0; c != 4; ++c)
+	v.color[c] = v.color[c] * color[c] / 255;
+      verts.push_back(v);
+    }
+    runs.back().count += from.count;
+  }
+}
@@ -0,0 +1,105 @@
+/*
+ * regame: recycling game - sprite batching
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef batch_hh
+#define batch_hh
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+
+
+/*
+ * Structures
+ */
+
+struct Vertex
+{
+  float x, y;
+  float u, v;
+  unsigned char color[4];
+};
+
+
+// 2D affine transform: x' = a*x + c*y + tx, y' = b*x + d*y + ty
+struct Affine
+{
+  Affine()
+  : a(1), b(0), c(0), d(1), tx(0), ty(0)
+  {}
+
+  Affine(float a, float b, float c, float d, float tx, float ty)
+  : a(a), b(b), c(c), d(d), tx(tx), ty(ty)
+  {}
+
+  static Affine translate(float x, float y)
+  { return Affine(1, 0, 0, 1, x, y); }
+
+  static Affine scale(float x, float y)
+  { return Affine(x, 0, 0, y, 0, 0); }
+
+  static Affine rotate(double deg);
+
+  Affine operator*(const Affine& r) const
+  {
+    return Affine(a * r.a + c * r.b, b * r.a + d * r.b,
+	a * r.c + c * r.d, b * r.c + d * r.d,
+	a * r.tx + c * r.ty + tx, b * r.tx + d * r.ty + ty);
+  }
+
+  float a, b, c, d;
+  float tx, ty;
+};
+
+
+/*
+ * Sprite batch: transformed quads accumulated on the CPU, grouped in runs of
+ * consecutive quads sharing the same texture. The batch is reused across
+ * frames to avoid reallocations.
+ */
+
+class SpriteBatch
+{
+public:
+  struct Run
+  {
+    unsigned int tex;
+    size_t first;	// first vertex
+    size_t count;	// number of vertices
+  };
+
+  vector<Vertex> verts;
+  vector<Run> runs;
+
+  void clear()
+  {
+    verts.clear();
+    runs.clear();
+  }
+
+  // room for n quads (each in its own run) without reallocating
+  void reserve(size_t n)
+  {
+    verts.reserve(n * 4);
+    runs.reserve(n);
+  }
+
+  // sprite s with its lower-left corner at p, transformed by m
+  void add(const Sprite& s, const Affine& m, const Point2f& p,
+      float r, float g, float b, float a);
+
+  void add(const Sprite& s, const Affine& m, const Point2f& p,
+      const float a = 1.)
+  { add(s, m, p, 1, 1, 1, a); }
+
+  // all the quads of another batch, translated and tinted
+  void add(const SpriteBatch& src, float x, float y,
+      float r, float g, float b, float a);
+};
+
+#endif
@@ -0,0 +1,403 @@
+/*
+ * regame: recycling game - headless simulation benchmark
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+#include "integrate.hh"
+#include "input.hh"
+#include "control.hh"
+#include "timing.hh"
+#include "scene.hh"
+#include "soft.hh"
+#include "alloc.hh"
+#include "preload.hh"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+
+/*
+ * Constants
+ */
+
+namespace
+{
+  const char gameData[] = "game.txt";
+}
+
+
+/*
+ * Utilities
+ */
+
+int
+inFlight(const ParticlePool& p)
+{
+  int n = 0;
+  for(size_t i = 0; i != p.size(); ++i)
+    n += (p.grabbed[i] != 0);
+  return n;
+}
+
+
+void
+usage(const char* prg)
+{
+  fprintf(stderr, "usage: %s [-d dir] [-l level] [-n worlds] [-t msecs] [-s step] [-p n]\n"
+      "\t[-k kernel] [-c n] [-g n] [-a] [-r log] [-w] [-b kernel] [-L n]\n"
+      "  -d dir\tgame data directory (.)\n"
+      "  -l level\tlevel number (0)\n"
+      "  -n worlds\tnumber of independent worlds (100)\n"
+      "  -t msecs\tsimulated time per world (600000)\n"
+      "  -s step\tsimulation step in msecs (16)\n"
+      "  -p n\t\tstart each world with n falling particles (0)\n"
+      "  -k kernel\tintegration kernel (scalar, sse2, avx2)\n"
+      "  -c n\t\tspread n containers (and object types) over the level\n"
+      "  -g n\t\tkeep n thrown objects in flight\n"
+      "  -a\t\tlet the autopilot play\n"
+      "  -r log\treplay a recorded game in each world instead\n"
+      "  -w\t\tdraw each step with the software renderer, timing the frames\n"
+      "  -b kernel\tsoftware blending kernel (scalar, sse2, avx2)\n"
+      "  -L n\t\tjust load the level n times, as a level change does\n", prg);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  string dataDir = ".";
+  int level = 0;
+  int worlds = 100;
+  int msecs = 600000;
+  int step = 16;
+  int fill = 0;
+  int cnts = 0;
+  int thrown = 0;
+  bool autopilot = false;
+  const char* replayFile = NULL;
+  bool render = false;
+  int loads = 0;
+
+  int c;
+  while((c = getopt(argc, argv, "d:l:n:t:s:p:k:c:g:ar:wb:L:h")) != -1)
+  {
+    switch(c)
+    {
+    case 'd': dataDir = optarg; break;
+    case 'l': level = atoi(optarg); break;
+    case 'n': worlds = atoi(optarg); break;
+    case 't': msecs = atoi(optarg); break;
+    case 's': step = atoi(optarg); break;
+    case 'p': fill = atoi(optarg); break;
+    case 'c': cnts = atoi(optarg); break;
+    case 'g': thrown = atoi(optarg); break;
+    case 'a': autopilot = true; break;
+    case 'r': replayFile = optarg; break;
+    case 'w': render = true; break;
+    case 'L': loads = atoi(optarg); break;
+    case 'b':
+      if(setSoftKernel(optarg))
+      {
+	fprintf(stderr, "%s: kernel %s not available\n", argv[0], optarg);
+	return EXIT_FAILURE;
+      }
+      break;
+    case 'k':
+      if(setIntegrateKernel(optarg))
+      {
+	fprintf(stderr, "%s: kernel %s not available\n", argv[0], optarg);
+	return EXIT_FAILURE;
+      }
+      break;
+    default:
+      usage(argv[0]);
+      return (c == 'h'? EXIT_SUCCESS: EXIT_FAILURE);
+    }
+  }
+  if(worlds < 1 || msecs < 1 || step < 1)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // load the level
+  string buf = dataDir + "/" + gameData;
+  string_map sm;
+  if(loadPairs(sm, buf.c_str()))
+  {
+    fprintf(stderr, "%s: cannot load game data from %s\n", argv[0], buf.c_str());
+    return EXIT_FAILURE;
+  }
+
+  // a recorded game knows its level
+  InputLog log;
+  string name;
+  if(replayFile)
+  {
+    if(log.load(replayFile))
+    {
+      fprintf(stderr, "%s: cannot load input log %s\n", argv[0], replayFile);
+      return EXIT_FAILURE;
+    }
+    name = log.level;
+  }
+  else
+  {
+    string_map::const_iterator st = sm.find(numbered("level", level));
+    if(st == sm.end())
+    {
+      fprintf(stderr, "%s: no such level %d\n", argv[0], level);
+      return EXIT_FAILURE;
+    }
+    name = st->second;
+  }
+  buf = dataDir + "/" + name;
+
+  if(loads > 0)
+  {
+    // parameters, sprite sizes, decoded images into textures and the
+    // simulation's copy, all gone when the level ends
+    double elapsed = 0;
+    double params = 0;
+    double worst = 0;
+    long allocs = allocations();
+    for(int i = 0; i != loads; ++i)
+    {
+      double start = monotonic();
+      {
+	Arena arena;
+	Level data(&arena);
+	SoftRenderer renderer;
+	bool err = (loadLevel(data, buf.c_str())
+	    || loadSpriteSizes(data, dataDir));
+	params += monotonic() - start;
+	if(err || loadSoftLevel(renderer, data, dataDir))
+	{
+	  fprintf(stderr, "%s: cannot load level %s\n", argv[0], buf.c_str());
+	  return EXIT_FAILURE;
+	}
+	data.name = name;
+	World world(data);
+      }
+      double t = monotonic() - start;
+      elapsed += t;
+      if(t > worst) worst = t;
+    }
+    allocs = allocations() - allocs;
+
+    // the same prepared in the background while a level is "played" for a
+    // while, as the game does: only the upload is left at the transition
+    double transition = 0;
+    long preAllocs = allocations();
+    long transAllocs = 0;
+    Preloader preloader;
+    for(int i = 0; i != loads; ++i)
+    {
+      preloader.start(dataDir.c_str(), NULL, name);
+      sleepUntil(monotonic() + 0.02);
+      double start = monotonic();
+      long before = allocations();
+      {
+	PreparedLevel* level = preloader.take();
+	SoftRenderer renderer;
+	if(!level || uploadSoftLevel(renderer, level->data, level->assets))
+	{
+	  fprintf(stderr, "%s: cannot load level %s\n", argv[0], buf.c_str());
+	  return EXIT_FAILURE;
+	}
+	level->data.name = name;
+	World world(level->data);
+	delete level;
+      }
+      transition += monotonic() - start;
+      transAllocs += allocations() - before;
+    }
+    preAllocs = allocations() - preAllocs - transAllocs;
+
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("loads: %d, level: %s\n", loads, name.c_str());
+    printf("ms/load: %.3f (parameters %.4f)\n", elapsed * 1e3 / loads,
+	params * 1e3 / loads);
+    printf("worst ms/load: %.3f\n", worst * 1e3);
+    printf("ms/transition (preloaded): %.3f\n", transition * 1e3 / loads);
+    printf("peak RSS: %ld KiB\n", ru.ru_maxrss);
+    if(allocations() >= 0)
+    {
+      printf("heap allocations/load: %ld\n", allocs / loads);
+      printf("heap allocations/transition (preloaded): %ld (background %ld)\n",
+	  transAllocs / loads, preAllocs / loads);
+    }
+    return EXIT_SUCCESS;
+  }
+
+  Level data;
+  if(loadLevel(data, buf.c_str()) || loadSpriteSizes(data, dataDir))
+  {
+    fprintf(stderr, "%s: cannot load level %s\n", argv[0], buf.c_str());
+    return EXIT_FAILURE;
+  }
+  data.name = name;
+
+  // the frames as the game would draw them, text aside
+  SoftRenderer renderer;
+  if(render)
+  {
+    if(loadSoftLevel(renderer, data, dataDir))
+    {
+      fprintf(stderr, "%s: cannot load the images of %s\n", argv[0],
+	  buf.c_str());
+      return EXIT_FAILURE;
+    }
+    renderer.resize(data.w, data.h);
+  }
+  Scene scene;
+  Random shake;
+  SpriteBatch batch;
+  Snapshot snap;
+  long frames = 0;
+  double drawn = 0;
+  double worstFrame = 0;
+
+  if(replayFile)
+  {
+    // the same session, over and over
+    World game(data);
+    ReplayStats st;
+    long steps = 0;
+    double elapsed = 0;
+    double worst = 0;
+    for(int i = 0; i != worlds; ++i)
+    {
+      if(replay(game, log, st))
+      {
+	fprintf(stderr, "%s: replay mismatch: score %d (%d), lives %d (%d)\n",
+	    argv[0], game.score, log.score, game.lives, log.lives);
+	return EXIT_FAILURE;
+      }
+      steps += st.steps;
+      elapsed += st.elapsed;
+      if(st.worstStep > worst) worst = st.worstStep;
+    }
+
+    printf("replays: %d, level: %s, step: %u ms, kernel: %s\n",
+	worlds, name.c_str(), log.step, integrateKernel());
+    printf("steps: %ld, elapsed: %.3f s\n", steps, elapsed);
+    printf("steps/sec: %.0f\n", steps / elapsed);
+    printf("ms/step: %.4f\n", elapsed * 1e3 / steps);
+    printf("worst ms/step: %.4f\n", worst * 1e3);
+    printf("score: %d, lives: %d\n", game.score, game.lives);
+    return EXIT_SUCCESS;
+  }
+
+  // a crowded level: each new container accepts its own object type
+  int baseCnts = data.cnts.size();
+  if(cnts > baseCnts && !baseCnts)
+  {
+    fprintf(stderr, "%s: level %s has no containers to replicate\n", argv[0],
+	name.c_str());
+    return EXIT_FAILURE;
+  }
+  for(int i = baseCnts; i < cnts; ++i)
+  {
+    Container ct = data.cnts[i % baseCnts];
+    ct.accept = i;
+    ct.pos.x = static_cast<float>(i) * (data.w - ct.s.w) / (cnts - 1);
+    data.cnts.push_back(ct);
+    data.objs.push_back(data.objs[i % baseCnts]);
+  }
+  data.acceptIndex.build(data.cnts);
+
+  // nobody is playing: the worlds will reach the game over and keep
+  // spawning, which is exactly the late-game load we're after
+  vector<World> games(worlds, World(data));
+  double particles = 0;
+  long steps = 0;
+
+  for(int i = 0; i != worlds; ++i)
+  {
+    games[i].seed(i);
+    games[i].start();
+    games[i].fill(fill);
+  }
+
+  Autopilot pilot;
+  double start = monotonic();
+  for(int i = 0; i != worlds; ++i)
+  {
+    World& game = games[i];
+    ParticlePool& p = game.particles;
+    for(int t = 0; t < msecs; t += step)
+    {
+      // throw as the player would, all over the level
+      for(int n = inFlight(p); n < thrown; ++n)
+      {
+	p.add(rand() % data.w, data.player.y + data.playerAnim[0].h / 2,
+	    data.maxFallSpeed, rand() % data.cnts.size(), true,
+	    data.maxFallSpeed / 2, rand());
+      }
+
+      Dir dir = dirNone;
+      if(autopilot)
+      {
+	bool release = false;
+	dir = pilot.control(game, release);
+	if(release) game.release();
+      }
+
+      game.update(step, dir);
+      particles += game.particles.size();
+      ++steps;
+
+      if(render)
+      {
+	double frame = monotonic();
+	snap.capture(game);
+	batch.clear();
+	scene.build(batch, data, snap, 0, step, shake);
+	renderer.draw(batch);
+	frame = monotonic() - frame;
+	drawn += frame;
+	if(frame > worstFrame) worstFrame = frame;
+	++frames;
+      }
+    }
+  }
+  double elapsed = monotonic() - start - drawn;
+
+  int accepted = 0;
+  int lives = 0;
+  for(int i = 0; i != worlds; ++i)
+  {
+    accepted += games[i].pts;
+    lives += (games[i].lives > 0? games[i].lives: 0);
+  }
+
+  printf("worlds: %d, simulated: %d ms, step: %d ms, kernel: %s\n",
+      worlds, msecs, step, integrateKernel());
+  printf("containers: %d, thrown in flight: %d, accepted: %d, lives left: %d\n",
+      static_cast<int>(data.cnts.size()), thrown, accepted, lives);
+  printf("steps: %ld, elapsed: %.3f s\n", steps, elapsed);
+  printf("steps/sec: %.0f\n", steps / elapsed);
+  printf("ms/step: %.4f\n", elapsed * 1e3 / steps);
+  printf("real time: %.0fx\n", steps * step / (elapsed * 1e3));
+  printf("particles/step: %.1f\n", particles / steps);
+  printf("ns/particle: %.2f\n", (particles? elapsed * 1e9 / particles: 0.));
+  if(render)
+  {
+    printf("frames: %ld, %dx%d, blending: %s, draw calls: %d\n", frames,
+	renderer.w, renderer.h, softKernel(), renderer.drawCalls);
+    printf("ms/frame: %.4f\n", drawn * 1e3 / frames);
+    printf("worst ms/frame: %.4f\n", worstFrame * 1e3);
+  }
+
+  return EXIT_SUCCESS;
+}
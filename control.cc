@@ -0,0 +1,127 @@
+/*
+ * regame: recycling game - player controllers
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "control.hh"
+
+#include <math.h>
+
+
+/*
+ * Constants
+ */
+
+namespace
+{
+  const float margin = 4;	// pixels to keep inside acceptance windows
+}
+
+
+/*
+ * Implementation
+ */
+
+int
+Autopilot::container(const World& world) const
+{
+  const Level& data = world.data;
+  int best = -1;
+  float bestDist = 0;
+  for(size_t i = 0; i != data.cnts.size(); ++i)
+  {
+    const Container& ct = data.cnts[i];
+    float left = ct.pos.x + ct.accWin[0].x + margin;
+    float right = ct.pos.x + ct.accWin[1].x - margin;
+    if(ct.accept != world.grabType || left >= right
+    || ct.pos.y + ct.accWin[0].y >= data.topline)
+      continue;
+
+    float dist = fabs((left + right) / 2 - data.player.x);
+    if(best < 0 || dist < bestDist)
+    {
+      best = i;
+      bestDist = dist;
+    }
+  }
+  return best;
+}
+
+
+float
+Autopilot::chase(const World& world) const
+{
+  const Level& data = world.data;
+  const ParticlePool& p = world.particles;
+  const float grabTop = data.player.y + data.playerAnim[0].h;
+  const float reach = data.playerAnim[0].w / 2;
+  const float g = data.grav;
+
+  float best = NAN;
+  float bestTime = HUGE_VALF;
+  for(size_t i = 0; i != p.size(); ++i)
+  {
+    if(p.grabbed[i] || p.y[i] < data.player.y) continue;
+
+    // time to fall into the grab zone: h + sy * t - g * t^2 / 2 = 0
+    float h = p.y[i] - grabTop;
+    float t;
+    if(h <= 0) t = 0;
+    else if(g > 0) t = (p.sy[i] + sqrtf(p.sy[i] * p.sy[i] + 2 * g * h)) / g;
+    else if(p.sy[i] < 0) t = h / -p.sy[i];
+    else continue;
+
+    float dist = fabs(p.x[i] - data.player.x) - reach;
+    if(t < bestTime && dist <= data.maxPlayerSpeed * t)
+    {
+      best = p.x[i];
+      bestTime = t;
+    }
+  }
+  return best;
+}
+
+
+Dir
+Autopilot::control(const World& world, bool& release)
+{
+  const Level& data = world.data;
+  if(!world.started) return dirNone;
+
+  float target;
+  if(world.grabbed)
+  {
+    int c = container(world);
+    if(c < 0)
+    {
+      // nowhere to put it: free the hands
+      release = true;
+      return dirNone;
+    }
+
+    const Container& ct = data.cnts[c];
+    float left = ct.pos.x + ct.accWin[0].x + margin;
+    float right = ct.pos.x + ct.accWin[1].x - margin;
+    release = (data.player.x > left && data.player.x < right);
+    target = (left + right) / 2;
+  }
+  else
+  {
+    target = chase(world);
+    if(isnan(target))
+      target = (data.fallWin[0] + data.fallWin[1]) / 2.f;
+  }
+
+  // steer, braking early enough not to overshoot
+  float dx = target - data.player.x;
+  float sx = data.player.sx;
+  float stop = sx * sx / (2 * data.playerAccel);
+  if(fabs(dx) < 1) return dirNone;
+  if(dx > 0) return (sx > 0 && stop >= dx? dirNone: dirRight);
+  return (sx < 0 && stop >= -dx? dirNone: dirLeft);
+}
@@ -0,0 +1,50 @@
+/*
+ * regame: recycling game - player controllers
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef control_hh
+#define control_hh
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+
+
+/*
+ * Controllers replace the keyboard: they're asked for the input before each
+ * simulation step.
+ */
+
+class Controller
+{
+public:
+  virtual ~Controller()
+  {}
+
+  // direction for the next step; set release to throw the grabbed object
+  virtual Dir control(const World& world, bool& release) = 0;
+};
+
+
+/*
+ * Plays by itself: chases the falling object it can reach first and throws
+ * it from under a container accepting it. Thrown objects rise straight up
+ * and are only caught below the topline, so containers whose window is
+ * above it are never targeted.
+ */
+
+class Autopilot: public Controller
+{
+  // x of the object to catch (NAN if none), container to throw into (-1)
+  float chase(const World& world) const;
+  int container(const World& world) const;
+
+public:
+  Dir control(const World& world, bool& release);
+};
+
+#endif
@@ -0,0 +1,266 @@
+/*
+ * regame: recycling game - damage tracking for partial redraws
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "damage.hh"
+
+#include <math.h>
+
+#include <algorithm>
+
+
+/*
+ * Utilities
+ */
+
+namespace
+{
+  // FNV-1a over the texture and the four vertices of a quad
+  uint64_t
+  quadKey(unsigned int tex, const Vertex* v)
+  {
+    uint64_t h = 14695981039346656037ULL;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(&tex);
+    for(size_t i = 0; i != sizeof(tex); ++i)
+      h = (h ^ p[i]) * 1099511628211ULL;
+    p = reinterpret_cast<const unsigned char*>(v);
+    for(size_t i = 0; i != 4 * sizeof(Vertex); ++i)
+      h = (h ^ p[i]) * 1099511628211ULL;
+    return h;
+  }
+
+
+  inline bool
+  overlaps(const DamageRect& a, const DamageRect& b)
+  {
+    return (a.x < b.x + b.w && b.x < a.x + a.w
+	&& a.y < b.y + b.h && b.y < a.y + a.h);
+  }
+}
+
+
+
+/*
+ * Implementation
+ */
+
+DamageRect
+DamageTracker::bounds(const SpriteBatch& batch, size_t i)
+{
+  const Vertex* v = &batch.verts[i];
+  float x0 = v[0].x, x1 = v[0].x;
+  float y0 = v[0].y, y1 = v[0].y;
+  for(int n = 1; n != 4; ++n)
+  {
+    x0 = std::min(x0, v[n].x);
+    x1 = std::max(x1, v[n].x);
+    y0 = std::min(y0, v[n].y);
+    y1 = std::max(y1, v[n].y);
+  }
+
+  // one more pixel around for the filtering
+  DamageRect r;
+  r.x = static_cast<int>(floorf(x0)) - 1;
+  r.y = static_cast<int>(floorf(y0)) - 1;
+  r.w = static_cast<int>(ceilf(x1)) + 1 - r.x;
+  r.h = static_cast<int>(ceilf(y1)) + 1 - r.y;
+  return r;
+}
+
+
+void
+DamageTracker::select(SpriteBatch& dst, const SpriteBatch& src,
+    const DamageRect& r)
+{
+  dst.clear();
+  for(size_t n = 0; n != src.runs.size(); ++n)
+  {
+    const SpriteBatch::Run& from = src.runs[n];
+    for(size_t i = from.first; i != from.first + from.count; i += 4)
+    {
+      if(!overlaps(bounds(src, i), r)) continue;
+      if(!dst.runs.size() || dst.runs.back().tex != from.tex)
+      {
+	SpriteBatch::Run run;
+	run.tex = from.tex;
+	run.first = dst.verts.size();
+	run.count = 0;
+	dst.runs.push_back(run);
+      }
+      dst.verts.insert(dst.verts.end(), &src.verts[i], &src.verts[i] + 4);
+      dst.runs.back().count += 4;
+    }
+  }
+}
+
+
+void
+DamageTracker::reset(int w, int h)
+{
+  this->w = w;
+  this->h = h;
+  cols = (w + tile - 1) / tile;
+  rows = (h + tile - 1) / tile;
+  history.assign(maxAge * cols * rows, 1);
+  head = 0;
+  dirty.assign(cols * rows, 0);
+  rects.reserve(cols * rows);
+  prev.clear();
+  full = true;
+}
+
+
+void
+DamageTracker::reserve(size_t n)
+{
+  prev.reserve(n);
+  cur.reserve(n);
+}
+
+
+void
+DamageTracker::mark(const DamageRect& r)
+{
+  int c0 = std::max(r.x / tile, 0);
+  int r0 = std::max(r.y / tile, 0);
+  int c1 = std::min((r.x + r.w - 1) / tile, cols - 1);
+  int r1 = std::min((r.y + r.h - 1) / tile, rows - 1);
+  for(int y = r0; y <= r1; ++y)
+    for(int x = c0; x <= c1; ++x)
+      history[head + y * cols + x] = 1;
+}
+
+
+void
+DamageTracker::update(const SpriteBatch& batch, int age)
+{
+  cur.clear();
+  for(size_t n = 0; n != batch.runs.size(); ++n)
+  {
+    const SpriteBatch::Run& run = batch.runs[n];
+    for(size_t i = run.first; i != run.first + run.count; i += 4)
+    {
+      Quad q;
+      q.key = quadKey(run.tex, &batch.verts[i]);
+      q.r = bounds(batch, i);
+      cur.push_back(q);
+    }
+  }
+  std::sort(cur.begin(), cur.end());
+
+  // the oldest frame's slice goes to this one
+  size_t n = cols * rows;
+  head = (head + n) % history.size();
+  unsigned char* mask = &history[head];
+  if(full)
+  {
+    full = false;
+    std::fill(mask, mask + n, 1);
+  }
+  else
+  {
+    // what's only in one of the frames (counting duplicates)
+    std::fill(mask, mask + n, 0);
+    size_t a = 0, b = 0;
+    while(a != cur.size() || b != prev.size())
+    {
+      if(b == prev.size() || (a != cur.size() && cur[a].key < prev[b].key))
+	mark(cur[a++].r);
+      else if(a == cur.size() || prev[b].key < cur[a].key)
+	mark(prev[b++].r);
+      else
+      {
+	++a;
+	++b;
+      }
+    }
+  }
+
+  prev.swap(cur);
+
+  // the damage of every frame since the buffer was drawn
+  if(age < 1 || age > maxAge)
+    std::fill(dirty.begin(), dirty.end(), 1);
+  else
+  {
+    std::copy(mask, mask + n, dirty.begin());
+    for(int f = 1; f != age; ++f)
+    {
+      const unsigned char* old = &history[(head + history.size() - f * n)
+	  % history.size()];
+      for(size_t i = 0; i != n; ++i)
+	dirty[i] |= old[i];
+    }
+  }
+  merge();
+}
+
+
+void
+DamageTracker::merge()
+{
+  // runs of dirty tiles per row, extending the rectangles of the row below
+  // when they span the same columns
+  rects.clear();
+  size_t below = 0;
+  for(int y = 0; y != rows; ++y)
+  {
+    size_t row = rects.size();
+    for(int x = 0; x != cols;)
+    {
+      if(!dirty[y * cols + x])
+      {
+	++x;
+	continue;
+      }
+      int start = x;
+      while(x != cols && dirty[y * cols + x]) ++x;
+
+      size_t i = below;
+      while(i != row && (rects[i].x != start || rects[i].w != x - start))
+	++i;
+      if(i != row)
+      {
+	// move it to this row
+	DamageRect r = rects[i];
+	++r.h;
+	rects.erase(rects.begin() + i);
+	--row;
+	rects.push_back(r);
+      }
+      else
+      {
+	DamageRect r = {start, y, x - start, 1};
+	rects.push_back(r);
+      }
+    }
+    below = row;
+  }
+
+  // to pixels, clipped to the window
+  long area = 0;
+  for(size_t i = 0; i != rects.size(); ++i)
+  {
+    DamageRect& r = rects[i];
+    r.x *= tile;
+    r.y *= tile;
+    r.w = std::min(r.w * tile, w - r.x);
+    r.h = std::min(r.h * tile, h - r.y);
+    area += static_cast<long>(r.w) * r.h;
+  }
+  whole = (rects.size() > maxRects
+      || area * 100 > static_cast<long>(w) * h * maxTouched);
+  if(whole)
+  {
+    DamageRect r = {0, 0, w, h};
+    rects.assign(1, r);
+    area = static_cast<long>(w) * h;
+  }
+  touched = (w && h? static_cast<double>(area) / (static_cast<long>(w) * h): 0);
+}
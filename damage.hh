@@ -0,0 +1,100 @@
+/*
+ * regame: recycling game - damage tracking for partial redraws
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef damage_hh
+#define damage_hh
+
+/*
+ * Headers
+ */
+
+#include "batch.hh"
+
+#include <stdint.h>
+
+
+/*
+ * Structures
+ */
+
+// in window pixels, origin at the bottom left like the batch
+struct DamageRect
+{
+  int x, y;
+  int w, h;
+};
+
+
+/*
+ * Finds what changed between two frames of a batch: every quad is compared
+ * with the previous frame's, and the tiles under quads which appeared, moved
+ * or vanished are dirty. The buffer drawn into holds a frame some frames old
+ * (its age: 1 if it keeps the last one, as a CPU framebuffer does, 2 for a
+ * swapped pair, more with longer swap chains), so the damage of that many
+ * frames is redrawn, or everything when the age is unknown or too old;
+ * dirty tiles are merged into a few rectangles.
+ */
+
+class DamageTracker
+{
+  struct Quad
+  {
+    uint64_t key;
+    DamageRect r;
+
+    bool operator<(const Quad& q) const
+    { return key < q.key; }
+  };
+
+  int w, h;
+  int cols, rows;
+  bool full;			// the next frame is all new
+  vector<Quad> prev, cur;
+  vector<unsigned char> history;	// damage of the last maxAge frames
+  int head;			// slice of this frame
+  vector<unsigned char> dirty;	// to redraw
+
+  void mark(const DamageRect& r);
+  void merge();
+
+public:
+  // beyond either redrawing everything at once is cheaper
+  enum
+  {
+    tile = 16,			// pixels
+    maxRects = 64,
+    maxTouched = 50,		// percent of the window
+    maxAge = 4			// frames of damage kept
+  };
+
+  // to redraw, and the fraction of the window they cover
+  vector<DamageRect> rects;
+  double touched;
+  bool whole;			// just the whole window
+
+  DamageTracker()
+  : w(0), h(0), cols(0), rows(0), full(false), head(0), touched(0),
+    whole(false)
+  {}
+
+  // new size or contents lost: everything is dirty, in any buffer
+  void reset(int w, int h);
+
+  // room for frames of n quads
+  void reserve(size_t n);
+
+  // drawing into a buffer age frames old, 0 if unknown (after reset())
+  void update(const SpriteBatch& batch, int age);
+
+  // bounds of the i-th quad (first vertex) of a batch
+  static DamageRect bounds(const SpriteBatch& batch, size_t i);
+
+  // the quads of src overlapping r, in the same order
+  static void select(SpriteBatch& dst, const SpriteBatch& src,
+      const DamageRect& r);
+};
+
+#endif
@@ -0,0 +1,280 @@
+/*
+ * regame: recycling game - offscreen frame rendering
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+#include "input.hh"
+#include "scene.hh"
+#include "soft.hh"
+#include "timing.hh"
+#include "alloc.hh"
+
+#include <algorithm>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+
+/*
+ * Utilities
+ */
+
+void
+usage(const char* prg)
+{
+  fprintf(stderr, "usage: %s [-d dir] [-o dir] [-g dir] [-e n] [-t n] [-p pct] [-m msecs]\n"
+      "\t[-c file] [-b kernel] [-z n] log\n"
+      "  -d dir\tgame data directory (.)\n"
+      "  -o dir\twrite the frames as dir/step-NNNNNN.png\n"
+      "  -g dir\tcompare with the golden frames in dir, where present\n"
+      "  -e n\t\tdraw every n-th step (4)\n"
+      "  -t n\t\ttolerance per channel (2)\n"
+      "  -p pct\tpixels allowed beyond the tolerance, per frame (0.1)\n"
+      "  -m msecs\tfail if the mean render time exceeds msecs\n"
+      "  -c file\tper-frame CSV of render times and mismatches\n"
+      "  -b kernel\tsoftware blending kernel (scalar, sse2, avx2)\n"
+      "  -z n\t\tfail on heap allocations after the first n steps\n"
+      "\t\t(needs a COUNT_ALLOCS build)\n", prg);
+}
+
+
+// pixels with a channel beyond tol, -1 if the sizes differ
+long
+mismatches(const Image& a, const Image& b, int tol)
+{
+  if(a.w != b.w || a.h != b.h || a.chans != b.chans)
+    return -1;
+
+  long n = 0;
+  for(size_t i = 0; i < a.px.size(); i += a.chans)
+  {
+    for(int c = 0; c != a.chans; ++c)
+    {
+      if(abs(a.px[i + c] - b.px[i + c]) > tol)
+      {
+	++n;
+	break;
+      }
+    }
+  }
+  return n;
+}
+
+
+double
+percentile(const vector<double>& v, double p)
+{
+  return (v.size()? v[static_cast<size_t>(p / 100. * (v.size() - 1) + 0.5)]: 0);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  string dataDir = ".";
+  const char* outDir = NULL;
+  const char* goldDir = NULL;
+  const char* csvFile = NULL;
+  int every = 4;
+  int tol = 2;
+  double maxBad = 0.1;
+  double budget = 0;
+  long warmup = -1;
+
+  int c;
+  while((c = getopt(argc, argv, "d:o:g:e:t:p:m:c:b:z:h")) != -1)
+  {
+    switch(c)
+    {
+    case 'd': dataDir = optarg; break;
+    case 'o': outDir = optarg; break;
+    case 'g': goldDir = optarg; break;
+    case 'e': every = atoi(optarg); break;
+    case 't': tol = atoi(optarg); break;
+    case 'p': maxBad = atof(optarg); break;
+    case 'm': budget = atof(optarg); break;
+    case 'c': csvFile = optarg; break;
+    case 'z': warmup = atol(optarg); break;
+    case 'b':
+      if(setSoftKernel(optarg))
+      {
+	fprintf(stderr, "%s: kernel %s not available\n", argv[0], optarg);
+	return EXIT_FAILURE;
+      }
+      break;
+    default:
+      usage(argv[0]);
+      return (c == 'h'? EXIT_SUCCESS: EXIT_FAILURE);
+    }
+  }
+  if(optind + 1 != argc || every < 1 || tol < 0 || maxBad < 0)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if(warmup >= 0 && allocations() < 0)
+  {
+    fprintf(stderr, "%s: heap allocations are not counted in this build\n",
+	argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // the session knows its level
+  InputLog log;
+  if(log.load(argv[optind]))
+  {
+    fprintf(stderr, "%s: cannot load input log %s\n", argv[0], argv[optind]);
+    return EXIT_FAILURE;
+  }
+
+  string buf = dataDir + "/" + log.level;
+
+  Level data;
+  if(loadLevel(data, buf.c_str()) || loadSpriteSizes(data, dataDir))
+  {
+    fprintf(stderr, "%s: cannot load level %s\n", argv[0], buf.c_str());
+    return EXIT_FAILURE;
+  }
+  data.name = log.level;
+
+  SoftRenderer renderer;
+  if(loadSoftLevel(renderer, data, dataDir))
+  {
+    fprintf(stderr, "%s: cannot load the images of %s\n", argv[0],
+	buf.c_str());
+    return EXIT_FAILURE;
+  }
+  renderer.resize(data.w, data.h);
+
+  FILE* csv = NULL;
+  if(csvFile)
+  {
+    if(!(csv = fopen(csvFile, "w")))
+    {
+      fprintf(stderr, "%s: cannot write %s\n", argv[0], csvFile);
+      return EXIT_FAILURE;
+    }
+    fprintf(csv, "step,ms,render,mismatches\n");
+  }
+
+  // text aside, the frames the game would have drawn right at each step
+  World world(data);
+  Replayer replayer(world, log);
+  Scene scene;
+  SpriteBatch batch;
+  Snapshot snap;
+  Random shake;
+  Image img, gold;
+  vector<double> times;
+  int compared = 0;
+  int failed = 0;
+  long steady = 0;
+  long firstAlloc = -1;
+  bool done = false;
+
+  // as the game does
+  size_t n = particleCapacity(data, log.step);
+  world.particles.reserve(n);
+  snap.reserve(n);
+  batch.reserve(scene.reserve(data, n));
+
+  for(long steps = 0; !done; ++steps)
+  {
+    // laid out at every step for the player to keep facing the same way
+    // at any rate; the containers shake at random, the same for each step
+    // on any platform
+    long allocs = allocations();
+    double t = monotonic();
+    snap.capture(world);
+    batch.clear();
+    shake.seed(steps);
+    scene.build(batch, data, snap, 0, log.step, shake);
+    bool drawn = !(steps % every);
+    if(drawn) renderer.draw(batch);
+    t = monotonic() - t;
+    allocs = allocations() - allocs;
+    if(drawn)
+    {
+      times.push_back(t * 1e3);
+
+      // named after the step, whatever the rate
+      char name[32];
+      snprintf(name, sizeof(name), "step-%06ld.png", steps);
+      if(outDir || goldDir) renderer.read(img);
+      if(outDir && savePng(img, (string(outDir) + "/" + name).c_str()))
+      {
+	fprintf(stderr, "%s: cannot write %s/%s\n", argv[0], outDir, name);
+	return EXIT_FAILURE;
+      }
+
+      long bad = 0;
+      if(goldDir && !loadPng(gold, (string(goldDir) + "/" + name).c_str(), false))
+      {
+	++compared;
+	bad = mismatches(img, gold, tol);
+	if(bad < 0 || bad * 100. > maxBad * img.w * img.h)
+	{
+	  ++failed;
+	  if(bad < 0)
+	    fprintf(stderr, "%s: size mismatch\n", name);
+	  else
+	    fprintf(stderr, "%s: %ld pixels beyond %d\n", name, bad, tol);
+	}
+      }
+      if(csv) fprintf(csv, "%ld,%d,%.4f,%ld\n", steps, world.startms, t * 1e3, bad);
+    }
+
+    // the step counts too, the output doesn't
+    long before = allocations();
+    done = replayer.step(world);
+    allocs += allocations() - before;
+    if(allocs && warmup >= 0 && steps >= warmup)
+    {
+      steady += allocs;
+      if(firstAlloc < 0) firstAlloc = steps;
+    }
+  }
+  if(csv) fclose(csv);
+
+  double total = 0;
+  for(size_t i = 0; i != times.size(); ++i)
+    total += times[i];
+  double mean = total / times.size();
+  std::sort(times.begin(), times.end());
+
+  printf("session: %s, %d frames every %d steps, %dx%d, blending: %s\n",
+      log.level.c_str(), static_cast<int>(times.size()), every,
+      renderer.w, renderer.h, softKernel());
+  printf("ms/frame: mean %.4f, p50 %.4f, p95 %.4f, max %.4f\n", mean,
+      percentile(times, 50), percentile(times, 95), times.back());
+  if(goldDir)
+  {
+    printf("golden frames: %d compared, %d failed\n", compared, failed);
+    if(!compared) ++failed;	// nothing checked is not a pass
+  }
+
+  bool slow = (budget > 0 && mean > budget);
+  if(slow)
+    printf("mean render time over the %.4f ms budget\n", budget);
+  if(warmup >= 0)
+  {
+    printf("heap allocations after step %ld: %ld", warmup, steady);
+    if(firstAlloc >= 0) printf(", first at step %ld", firstAlloc);
+    printf("\n");
+  }
+  if(world.score != log.score || world.lives != log.lives)
+  {
+    printf("replay mismatch: score %d (%d), lives %d (%d)\n", world.score,
+	log.score, world.lives, log.lives);
+    return EXIT_FAILURE;
+  }
+
+  return (failed || slow || steady? EXIT_FAILURE: EXIT_SUCCESS);
+}
@@ -0,0 +1,181 @@
+/*
+ * regame: recycling game - image decoding
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "image.hh"
+
+#include <png.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/*
+ * Implementation
+ */
+
+int nextPower(int i)
+{
+  int r = 1;
+  while((r <<= 1) < i);
+  return r;
+}
+
+
+bool
+loadPng(Image& img, const char* file, bool alpha)
+{
+  FILE* fd = fopen(file, "rb");
+  if(!fd) return true;
+
+  png_structp png_ptr = png_create_read_struct(
+      PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if(!png_ptr)
+  {
+    fclose(fd);
+    return true;
+  }
+
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  if(!info_ptr)
+  {
+    png_destroy_read_struct(&png_ptr, NULL, NULL);
+    fclose(fd);
+    return true;
+  }
+
+  png_infop end_info = png_create_info_struct(png_ptr);
+  if(!end_info)
+  {
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    fclose(fd);
+    return true;
+  }
+
+  png_bytep* rows = NULL;
+
+  png_init_io(png_ptr, fd);
+  if(setjmp(png_jmpbuf(png_ptr)))
+  {
+    png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+    fclose(fd);
+    if(rows) delete[] rows;
+    return true;
+  }
+
+  png_read_info(png_ptr, info_ptr);
+  img.w = png_get_image_width(png_ptr, info_ptr);
+  img.h = png_get_image_height(png_ptr, info_ptr);
+
+  // enforce 8bit RGB/A.
+  png_set_gray_to_rgb(png_ptr);
+  png_set_palette_to_rgb(png_ptr);
+  png_set_expand(png_ptr);
+  png_set_strip_16(png_ptr);
+  if(alpha) png_set_add_alpha(png_ptr, 0xFF, PNG_FILLER_AFTER);
+  else png_set_strip_alpha(png_ptr);
+
+  img.chans = (alpha? 4: 3);
+  img.px.resize(img.w * img.h * img.chans);
+  rows = new png_bytep[img.h];
+  for(int y = 0; y != img.h; ++y)
+    rows[y] = &img.px[img.w * y * img.chans];
+
+  png_read_image(png_ptr, rows);
+  png_read_end(png_ptr, end_info);
+  png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+  fclose(fd);
+
+  delete[] rows;
+  return false;
+}
+
+
+bool
+savePng(const Image& img, const char* file)
+{
+  FILE* fd = fopen(file, "wb");
+  if(!fd) return true;
+
+  png_structp png_ptr = png_create_write_struct(
+      PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if(!png_ptr)
+  {
+    fclose(fd);
+    return true;
+  }
+
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  if(!info_ptr)
+  {
+    png_destroy_write_struct(&png_ptr, NULL);
+    fclose(fd);
+    return true;
+  }
+
+  png_bytep* rows = NULL;
+
+  png_init_io(png_ptr, fd);
+  if(setjmp(png_jmpbuf(png_ptr)))
+  {
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(fd);
+    if(rows) delete[] rows;
+    return true;
+  }
+
+  png_set_IHDR(png_ptr, info_ptr, img.w, img.h, 8,
+      (img.chans == 4? PNG_COLOR_TYPE_RGB_ALPHA: PNG_COLOR_TYPE_RGB),
+      PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+      PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png_ptr, info_ptr);
+
+  rows = new png_bytep[img.h];
+  for(int y = 0; y != img.h; ++y)
+    rows[y] = const_cast<png_bytep>(&img.px[img.w * y * img.chans]);
+  png_write_image(png_ptr, rows);
+  png_write_end(png_ptr, info_ptr);
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+  bool err = (fclose(fd) != 0);
+
+  delete[] rows;
+  return err;
+}
+
+
+void
+padPow2(Image& dst, const Image& src)
+{
+  int chans = src.chans;
+  dst.w = nextPower(src.w);
+  dst.h = nextPower(src.h);
+  dst.chans = chans;
+  dst.px.resize(dst.w * dst.h * chans);
+
+  unsigned char* nbuf = &dst.px[0];
+  const unsigned char* buf = &src.px[0];
+  int tw = dst.w;
+  for(int y = 0; y != src.h; ++y)
+    memcpy(
+	nbuf + tw * chans * y,
+	buf + src.w * chans * y,
+	src.w * chans);
+
+  // clamp to elimiate bleeding
+  for(int y = 0; y != src.h; ++y)
+    for(int x = src.w; x != tw; ++x)
+      memcpy(
+	  nbuf + tw * chans * y + x * chans,
+	  nbuf + tw * chans * y + src.w * chans - chans,
+	  chans);
+  for(int y = src.h; y != dst.h; ++y)
+    memcpy(
+	nbuf + tw * chans * y,
+	nbuf + tw * chans * (src.h - 1),
+	tw * chans);
+}
@@ -0,0 +1,54 @@
+/*
+ * regame: recycling game - image decoding
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef image_hh
+#define image_hh
+
+/*
+ * Headers
+ */
+
+#include "arena.hh"
+
+#include <vector>
+using std::vector;
+
+
+/*
+ * Structures
+ */
+
+// decoded for a level, in its arena
+typedef vector<unsigned char, ArenaAllocator<unsigned char> > Pixels;
+
+// 8bit RGB/A pixels, top row first
+struct Image
+{
+  int w, h;
+  int chans;
+  Pixels px;
+};
+
+
+/*
+ * Utilities
+ */
+
+int nextPower(int i);
+
+// decode a PNG: the pixel buffer is reused when large enough
+bool
+loadPng(Image& img, const char* file, bool alpha);
+
+// encode as PNG (RGB or RGBA as the image is): returns true on error
+bool
+savePng(const Image& img, const char* file);
+
+// copy to power-of-two dimensions, clamping the edges to avoid bleeding
+void
+padPow2(Image& dst, const Image& src);
+
+#endif
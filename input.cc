@@ -0,0 +1,190 @@
+/*
+ * regame: recycling game - input recording and replay
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "input.hh"
+#include "timing.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/*
+ * Constants
+ */
+
+namespace
+{
+  const char logMagic[4] = {'R', 'G', 'I', 'N'};
+  const uint32_t logVersion = 1;
+
+  struct LogHeader
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t seed;
+    uint32_t step;
+    uint32_t nameLen;
+    uint32_t count;
+    int32_t score;
+    int32_t lives;
+  };
+}
+
+
+/*
+ * Implementation
+ */
+
+void
+InputLog::clear()
+{
+  events.clear();
+  score = lives = 0;
+}
+
+
+void
+InputLog::add(int ms, InputType type, int key, Dir dir)
+{
+  InputEvent ev;
+  ev.ms = ms;
+  ev.type = type;
+  ev.dir = dir;
+  ev.key = key;
+  events.push_back(ev);
+}
+
+
+void
+InputLog::end(const World& world)
+{
+  add(world.startms, inEnd);
+  score = world.score;
+  lives = world.lives;
+}
+
+
+bool
+InputLog::load(const char* file)
+{
+  FILE* fd = fopen(file, "rb");
+  if(!fd) return true;
+
+  LogHeader hdr;
+  bool ret = (fread(&hdr, sizeof(hdr), 1, fd) != 1
+      || memcmp(hdr.magic, logMagic, 4) || hdr.version != logVersion
+      || !hdr.step || !hdr.count);
+  if(!ret)
+  {
+    level.resize(hdr.nameLen);
+    events.resize(hdr.count);
+    ret = ((hdr.nameLen && fread(&level[0], hdr.nameLen, 1, fd) != 1)
+	|| fread(&events[0], sizeof(InputEvent), hdr.count, fd) != hdr.count
+	|| events.back().type != inEnd);
+  }
+  fclose(fd);
+  if(ret) return true;
+
+  seed = hdr.seed;
+  step = hdr.step;
+  score = hdr.score;
+  lives = hdr.lives;
+  return false;
+}
+
+
+bool
+InputLog::save(const char* file) const
+{
+  LogHeader hdr;
+  memcpy(hdr.magic, logMagic, 4);
+  hdr.version = logVersion;
+  hdr.seed = seed;
+  hdr.step = step;
+  hdr.nameLen = level.size();
+  hdr.count = events.size();
+  hdr.score = score;
+  hdr.lives = lives;
+
+  FILE* fd = fopen(file, "wb");
+  if(!fd) return true;
+  bool ret = (fwrite(&hdr, sizeof(hdr), 1, fd) != 1);
+  ret |= (fwrite(level.data(), 1, level.size(), fd) != level.size());
+  if(events.size())
+    ret |= (fwrite(&events[0], sizeof(InputEvent), events.size(), fd)
+	!= events.size());
+  return (fclose(fd) || ret);
+}
+
+
+Replayer::Replayer(World& world, const InputLog& log)
+: log(log), next(0), key(0), dir(dirNone)
+{
+  world.reset();
+  world.seed(log.seed);
+  world.start();
+}
+
+
+bool
+Replayer::step(World& world)
+{
+  // same key tracking as the game window
+  for(; next != log.events.size()
+	&& world.startms >= static_cast<int>(log.events[next].ms); ++next)
+  {
+    const InputEvent& ev = log.events[next];
+    switch(ev.type)
+    {
+    case inKeyDown:
+      key = ev.key;
+      dir = static_cast<Dir>(ev.dir);
+      break;
+
+    case inKeyUp:
+      if(key == ev.key)
+      {
+	key = 0;
+	dir = dirNone;
+      }
+      break;
+
+    case inRelease:
+      world.release();
+      break;
+    }
+  }
+  if(next == log.events.size()) return true;
+
+  world.update(log.step, dir);
+  return false;
+}
+
+
+bool
+replay(World& world, const InputLog& log, ReplayStats& stats)
+{
+  Replayer r(world, log);
+  stats.steps = 0;
+  stats.worstStep = 0;
+  double start = monotonic();
+  double last = start;
+  while(!r.step(world))
+  {
+    ++stats.steps;
+
+    double now = monotonic();
+    if(now - last > stats.worstStep) stats.worstStep = now - last;
+    last = now;
+  }
+  stats.elapsed = monotonic() - start;
+
+  return (world.score != log.score || world.lives != log.lives);
+}
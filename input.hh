@@ -0,0 +1,106 @@
+/*
+ * regame: recycling game - input recording and replay
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef input_hh
+#define input_hh
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+
+#include <stdint.h>
+
+
+/*
+ * Structures
+ */
+
+enum InputType
+{
+  inKeyDown = 1,	// a direction key was pressed
+  inKeyUp,		// any direction key was released
+  inRelease,		// the grabbed object was thrown
+  inEnd			// end of the session
+};
+
+
+// one event, stamped with the world time it was applied at (native order)
+struct InputEvent
+{
+  uint32_t ms;
+  uint8_t type;
+  uint8_t dir;		// Dir of the key, for inKeyDown
+  uint16_t key;		// raw key code (only compared for equality)
+};
+
+
+// a single game session: from World::start() to the end event
+struct InputLog
+{
+  string level;		// Level::name
+  uint32_t seed;
+  uint32_t step;	// simulation step in msecs
+
+  vector<InputEvent> events;
+
+  // final state, for verification
+  int32_t score;
+  int32_t lives;
+
+  InputLog()
+  : seed(0), step(0), score(0), lives(0)
+  {}
+
+  void clear();
+  void add(int ms, InputType type, int key = 0, Dir dir = dirNone);
+  void end(const World& world);
+
+  // returns true on error
+  bool load(const char* file);
+  bool save(const char* file) const;
+};
+
+
+struct ReplayStats
+{
+  long steps;
+  double elapsed;	// secs
+  double worstStep;	// secs
+};
+
+
+/*
+ * Re-runs a session one step at a time, applying the logged input when the
+ * world reaches its time as the game window did.
+ */
+
+class Replayer
+{
+  const InputLog& log;
+  size_t next;
+  int key;
+  Dir dir;
+
+public:
+  // restarts the world with the session's seed
+  Replayer(World& world, const InputLog& log);
+
+  // apply what's due and advance one step: returns true at the end instead
+  bool step(World& world);
+};
+
+
+/*
+ * Re-run a session on the world, as fast as possible. Returns true when the
+ * final score/lives don't match the recorded ones.
+ */
+
+bool
+replay(World& world, const InputLog& log, ReplayStats& stats);
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ * regame: recycling game - particle integration kernels
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "integrate.hh"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INTEGRATE_X86
+#include <immintrin.h>
+#endif
+
+
+/*
+ * Kernels
+ */
+
+namespace
+{
+  typedef void (*Kernel)(float*, float*, float*, int*, size_t,
+      const IntegrateParams&);
+
+
+  inline void
+  integrate1(float& y, float& sy, float& maxSpeed, int& grabbed,
+      const IntegrateParams& p)
+  {
+    if(!grabbed || y > p.topline)
+    {
+      grabbed = false;
+      sy -= p.grav;
+      if(sy < -maxSpeed)
+	sy = -maxSpeed;
+    }
+    y += p.delta * sy;
+
+    if(!grabbed && y < p.bounceTop && maxSpeed > p.minSpeed)
+    {
+      y = p.baseline;
+      sy = maxSpeed;
+      maxSpeed /= 2;
+    }
+  }
+
+
+  void
+  integrateScalar(float* y, float* sy, float* maxSpeed, int* grabbed,
+      size_t n, const IntegrateParams& p)
+  {
+    for(size_t i = 0; i != n; ++i)
+      integrate1(y[i], sy[i], maxSpeed[i], grabbed[i], p);
+  }
+
+
+#ifdef INTEGRATE_X86
+  __attribute__((target("sse2"))) void
+  integrateSSE2(float* y, float* sy, float* maxSpeed, int* grabbed,
+      size_t n, const IntegrateParams& p)
+  {
+    const __m128 delta = _mm_set1_ps(p.delta);
+    const __m128 grav = _mm_set1_ps(p.grav);
+    const __m128 topline = _mm_set1_ps(p.topline);
+    const __m128 bounceTop = _mm_set1_ps(p.bounceTop);
+    const __m128 baseline = _mm_set1_ps(p.baseline);
+    const __m128 minSpeed = _mm_set1_ps(p.minSpeed);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 sign = _mm_set1_ps(-0.f);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+      __m128 vy = _mm_loadu_ps(y + i);
+      __m128 vsy = _mm_loadu_ps(sy + i);
+      __m128 vms = _mm_loadu_ps(maxSpeed + i);
+      __m128i vg = _mm_loadu_si128(reinterpret_cast<__m128i*>(grabbed + i));
+
+      // free falling: not grabbed or above the topline
+      __m128 fall = _mm_or_ps(
+	  _mm_castsi128_ps(_mm_cmpeq_epi32(vg, zero)),
+	  _mm_cmpgt_ps(vy, topline));
+      vg = _mm_andnot_si128(_mm_castps_si128(fall), vg);
+      __m128 nsy = _mm_max_ps(_mm_sub_ps(vsy, grav), _mm_xor_ps(vms, sign));
+      vsy = _mm_or_ps(_mm_and_ps(fall, nsy), _mm_andnot_ps(fall, vsy));
+      vy = _mm_add_ps(vy, _mm_mul_ps(delta, vsy));
+
+      // bounce
+      __m128 bounce = _mm_and_ps(
+	  _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(vg, zero)),
+	      _mm_cmplt_ps(vy, bounceTop)),
+	  _mm_cmpgt_ps(vms, minSpeed));
+      vy = _mm_or_ps(_mm_and_ps(bounce, baseline), _mm_andnot_ps(bounce, vy));
+      vsy = _mm_or_ps(_mm_and_ps(bounce, vms), _mm_andnot_ps(bounce, vsy));
+      vms = _mm_or_ps(_mm_and_ps(bounce, _mm_mul_ps(vms, half)),
+	  _mm_andnot_ps(bounce, vms));
+
+      _mm_storeu_ps(y + i, vy);
+      _mm_storeu_ps(sy + i, vsy);
+      _mm_storeu_ps(maxSpeed + i, vms);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(grabbed + i), vg);
+    }
+
+    for(; i != n; ++i)
+      integrate1(y[i], sy[i], maxSpeed[i], grabbed[i], p);
+  }
+
+
+  __attribute__((target("avx2"))) void
+  integrateAVX2(float* y, float* sy, float* maxSpeed, int* grabbed,
+      size_t n, const IntegrateParams& p)
+  {
+    const __m256 delta = _mm256_set1_ps(p.delta);
+    const __m256 grav = _mm256_set1_ps(p.grav);
+    const __m256 topline = _mm256_set1_ps(p.topline);
+    const __m256 bounceTop = _mm256_set1_ps(p.bounceTop);
+    const __m256 baseline = _mm256_set1_ps(p.baseline);
+    const __m256 minSpeed = _mm256_set1_ps(p.minSpeed);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 sign = _mm256_set1_ps(-0.f);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+      __m256 vy = _mm256_loadu_ps(y + i);
+      __m256 vsy = _mm256_loadu_ps(sy + i);
+      __m256 vms = _mm256_loadu_ps(maxSpeed + i);
+      __m256i vg = _mm256_loadu_si256(reinterpret_cast<__m256i*>(grabbed + i));
+
+      // free falling: not grabbed or above the topline
+      __m256 fall = _mm256_or_ps(
+	  _mm256_castsi256_ps(_mm256_cmpeq_epi32(vg, zero)),
+	  _mm256_cmp_ps(vy, topline, _CMP_GT_OQ));
+      vg = _mm256_andnot_si256(_mm256_castps_si256(fall), vg);
+      __m256 nsy = _mm256_max_ps(_mm256_sub_ps(vsy, grav),
+	  _mm256_xor_ps(vms, sign));
+      vsy = _mm256_blendv_ps(vsy, nsy, fall);
+      vy = _mm256_add_ps(vy, _mm256_mul_ps(delta, vsy));
+
+      // bounce
+      __m256 bounce = _mm256_and_ps(
+	  _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(vg, zero)),
+	      _mm256_cmp_ps(vy, bounceTop, _CMP_LT_OQ)),
+	  _mm256_cmp_ps(vms, minSpeed, _CMP_GT_OQ));
+      vy = _mm256_blendv_ps(vy, baseline, bounce);
+      vsy = _mm256_blendv_ps(vsy, vms, bounce);
+      vms = _mm256_blendv_ps(vms, _mm256_mul_ps(vms, half), bounce);
+
+      _mm256_storeu_ps(y + i, vy);
+      _mm256_storeu_ps(sy + i, vsy);
+      _mm256_storeu_ps(maxSpeed + i, vms);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(grabbed + i), vg);
+    }
+
+    for(; i != n; ++i)
+      integrate1(y[i], sy[i], maxSpeed[i], grabbed[i], p);
+  }
+#endif
+
+
+  struct KernelEntry
+  {
+    const char* name;
+    Kernel fn;
+  };
+
+  const KernelEntry kernels[] =
+  {
+#ifdef INTEGRATE_X86
+    {"avx2", integrateAVX2},
+    {"sse2", integrateSSE2},
+#endif
+    {"scalar", integrateScalar}
+  };
+
+  const size_t nKernels = sizeof(kernels) / sizeof(*kernels);
+  const KernelEntry* selected = NULL;
+
+
+  bool
+  available(const KernelEntry& k)
+  {
+#ifdef INTEGRATE_X86
+    if(k.fn == integrateAVX2) return __builtin_cpu_supports("avx2");
+    if(k.fn == integrateSSE2) return __builtin_cpu_supports("sse2");
+#endif
+    return true;
+  }
+
+
+  const KernelEntry*
+  select()
+  {
+    // the best one we can run
+    if(!selected)
+    {
+      size_t i = 0;
+      while(!available(kernels[i])) ++i;
+      selected = kernels + i;
+    }
+    return selected;
+  }
+}
+
+
+/*
+ * Implementation
+ */
+
+void
+integrate(float* y, float* sy, float* maxSpeed, int* grabbed,
+    size_t n, const IntegrateParams& p)
+{
+  select()->fn(y, sy, maxSpeed, grabbed, n, p);
+}
+
+
+const char*
+integrateKernel()
+{
+  return select()->name;
+}
+
+
+bool
+setIntegrateKernel(const char* name)
+{
+  for(size_t i = 0; i != nKernels; ++i)
+  {
+    if(!strcmp(kernels[i].name, name))
+    {
+      if(!available(kernels[i])) return true;
+      selected = kernels + i;
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,45 @@
+/*
+ * regame: recycling game - particle integration kernels
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef integrate_hh
+#define integrate_hh
+
+#include <stddef.h>
+
+
+/*
+ * Structures
+ */
+
+struct IntegrateParams
+{
+  float delta;
+  float grav;		// gravity * delta
+  float topline;	// thrown particles fall again above this
+  float bounceTop;	// free particles below this bounce...
+  float baseline;	// ...back to here
+  float minSpeed;	// unless they're too slow
+};
+
+
+/*
+ * Gravity, speed clamping, integration and baseline bounce for n particles,
+ * without branches. Grabbing, losing and accepting are left to the caller.
+ */
+
+void
+integrate(float* y, float* sy, float* maxSpeed, int* grabbed,
+    size_t n, const IntegrateParams& p);
+
+// name of the selected kernel ("scalar", "sse2", "avx2")
+const char*
+integrateKernel();
+
+// force a kernel by name: returns true if unavailable
+bool
+setIntegrateKernel(const char* name);
+
+#endif
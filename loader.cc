@@ -0,0 +1,111 @@
+/*
+ * regame: recycling game - parallel asset decoding
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "loader.hh"
+#include "timing.hh"
+
+
+/*
+ * Implementation
+ */
+
+Decoder::Decoder(int threads)
+: assets(NULL), next(0), pending(0), quit(false)
+{
+  if(threads < 1) threads = std::thread::hardware_concurrency();
+  if(threads < 1) threads = 1;
+  for(int i = 0; i != threads; ++i)
+    workers.push_back(std::thread(&Decoder::work, this));
+}
+
+
+Decoder::~Decoder()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    quit = true;
+  }
+  wake.notify_all();
+  for(size_t i = 0; i != workers.size(); ++i)
+    workers[i].join();
+}
+
+
+void
+Decoder::work()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  for(;;)
+  {
+    while(!quit && (!assets || next == assets->size()))
+      wake.wait(guard);
+    if(quit) break;
+
+    // decode one asset outside of the lock
+    Asset& a = (*assets)[next++];
+    guard.unlock();
+    double start = monotonic();
+    a.failed = loadPng(a.img, a.file.c_str(), a.alpha);
+    a.decodeTime = monotonic() - start;
+    guard.lock();
+
+    if(!--pending)
+      done.notify_all();
+  }
+}
+
+
+void
+Decoder::decode(vector<Asset>& assets)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  while(this->assets)
+    done.wait(guard);
+  this->assets = &assets;
+  next = 0;
+  pending = assets.size();
+  wake.notify_all();
+  while(pending)
+    done.wait(guard);
+  this->assets = NULL;
+  done.notify_all();
+}
+
+
+
+/*
+ * Utilities
+ */
+
+bool
+decodeLevel(vector<Asset>& assets, Level& data, const string& dataDir,
+    Decoder& decoder)
+{
+  vector<Sprite*> sprites;
+  vector<string> files;
+  levelSprites(data, sprites, files);
+
+  assets.resize(files.size() + 1);
+  assets[0].file = dataDir + "/" + backFile(data);
+  assets[0].alpha = false;
+  for(size_t i = 0; i != files.size(); ++i)
+  {
+    assets[i + 1].file = dataDir + "/" + files[i];
+    assets[i + 1].alpha = true;
+  }
+  for(size_t i = 0; i != assets.size(); ++i)
+    assets[i].img.px = Pixels(data.arena());
+  decoder.decode(assets);
+
+  bool ret = false;
+  for(size_t i = 0; i != assets.size(); ++i)
+    ret |= assets[i].failed;
+  return ret;
+}
@@ -0,0 +1,82 @@
+/*
+ * regame: recycling game - parallel asset decoding
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef loader_hh
+#define loader_hh
+
+/*
+ * Headers
+ */
+
+#include "image.hh"
+#include "world.hh"
+
+#include <string>
+using std::string;
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+/*
+ * Structures
+ */
+
+struct Asset
+{
+  string file;
+  bool alpha;
+
+  // results
+  Image img;
+  bool failed;
+  double decodeTime;
+};
+
+
+/*
+ * Worker pool decoding assets concurrently. Assets keep their pixel buffers
+ * across decodes, so reusing the same vector avoids reallocations.
+ */
+
+class Decoder
+{
+  vector<std::thread> workers;
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable done;
+
+  // current job
+  vector<Asset>* assets;
+  size_t next;
+  size_t pending;
+  bool quit;
+
+  void work();
+
+public:
+  // threads = 0: one per core
+  Decoder(int threads = 0);
+  ~Decoder();
+
+  // decode all the assets, blocking until done (and until any other
+  // caller is)
+  void decode(vector<Asset>& assets);
+};
+
+
+/*
+ * Utilities
+ */
+
+// the background, then the sprites in levelSprites() order, from the loose
+// files into the level's arena: returns true if any failed
+bool
+decodeLevel(vector<Asset>& assets, Level& data, const string& dataDir,
+    Decoder& decoder);
+
+#endif
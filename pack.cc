@@ -0,0 +1,401 @@
+/*
+ * regame: recycling game - preprocessed asset packs
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "pack.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+/*
+ * Constants
+ */
+
+namespace
+{
+  const char packMagic[4] = {'R', 'G', 'P', 'K'};
+  const uint32_t packVersion = 1;
+  const size_t packAlign = 16;
+
+  enum
+  {
+    typePairs = 1,
+    typeImage,
+    typeAtlas
+  };
+
+  struct PackHeader
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+  };
+
+  string
+  pageName(const string& name, size_t i)
+  {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "#%u", static_cast<unsigned>(i));
+    return name + buf;
+  }
+}
+
+
+/*
+ * Reader
+ */
+
+Pack::Pack()
+: base(NULL), size(0), mapped(false)
+{}
+
+
+Pack::~Pack()
+{
+  close();
+}
+
+
+void
+Pack::close()
+{
+  if(!base) return;
+#ifndef WIN32
+  if(mapped) munmap(const_cast<unsigned char*>(base), size);
+  else
+#endif
+  delete[] base;
+  base = NULL;
+  index.clear();
+}
+
+
+bool
+Pack::open(const char* file)
+{
+  close();
+
+#ifndef WIN32
+  int fd = ::open(file, O_RDONLY);
+  if(fd < 0) return true;
+  struct stat st;
+  if(fstat(fd, &st) || !st.st_size)
+  {
+    ::close(fd);
+    return true;
+  }
+  void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if(m == MAP_FAILED) return true;
+  base = static_cast<const unsigned char*>(m);
+  size = st.st_size;
+  mapped = true;
+#else
+  FILE* fd = fopen(file, "rb");
+  if(!fd) return true;
+  fseek(fd, 0, SEEK_END);
+  size = ftell(fd);
+  fseek(fd, 0, SEEK_SET);
+  unsigned char* buf = new unsigned char[size];
+  if(fread(buf, size, 1, fd) != 1)
+  {
+    delete[] buf;
+    fclose(fd);
+    return true;
+  }
+  fclose(fd);
+  base = buf;
+  mapped = false;
+#endif
+
+  // validate the directory (by subtraction: offsets plus lengths can wrap)
+  const PackHeader* hdr = reinterpret_cast<const PackHeader*>(base);
+  if(size < sizeof(PackHeader) || memcmp(hdr->magic, packMagic, 4)
+  || hdr->version != packVersion
+  || hdr->count > (size - sizeof(PackHeader)) / sizeof(PackEntry))
+  {
+    close();
+    return true;
+  }
+
+  const PackEntry* e = reinterpret_cast<const PackEntry*>(hdr + 1);
+  for(uint32_t i = 0; i != hdr->count; ++i, ++e)
+  {
+    if(e->nameOff > size || e->nameLen > size - e->nameOff
+    || e->off > size || e->size > size - e->off)
+    {
+      close();
+      return true;
+    }
+    index[Key(e->type, string(reinterpret_cast<const char*>(base + e->nameOff),
+		e->nameLen))] = e;
+  }
+
+  return false;
+}
+
+
+const PackEntry*
+Pack::find(const string& name, uint32_t type) const
+{
+  map<Key, const PackEntry*>::const_iterator it = index.find(Key(type, name));
+  return (it == index.end()? NULL: it->second);
+}
+
+
+bool
+Pack::pairs(string_map& sm, const string& name) const
+{
+  const PackEntry* e = find(name, typePairs);
+  if(!e) return true;
+
+  // key\0value\0...
+  const char* p = reinterpret_cast<const char*>(base + e->off);
+  const char* end = p + e->size;
+  while(p < end)
+  {
+    // both strings terminated within the entry
+    const char* k = static_cast<const char*>(memchr(p, 0, end - p));
+    if(!k) return true;
+    const char* v = k + 1;
+    const char* t = static_cast<const char*>(memchr(v, 0, end - v));
+    if(!t) return true;
+    sm.insert(make_pair(string(p, k), string(v, t)));
+    p = t + 1;
+  }
+
+  return false;
+}
+
+
+bool
+Pack::image(PackImage& img, const string& name) const
+{
+  const PackEntry* e = find(name, typeImage);
+  if(!e || static_cast<uint64_t>(e->tw) * e->th * e->chans > e->size)
+    return true;
+
+  img.w = e->w;
+  img.h = e->h;
+  img.chans = e->chans;
+  img.tw = e->tw;
+  img.th = e->th;
+  img.px = base + e->off;
+  return false;
+}
+
+
+bool
+Pack::atlas(vector<PackImage>& pages, vector<AtlasRect>& rects,
+    const string& name) const
+{
+  const PackEntry* e = find(name, typeAtlas);
+  if(!e || e->size < 2 * sizeof(uint32_t)) return true;
+
+  const uint32_t* p = reinterpret_cast<const uint32_t*>(base + e->off);
+  uint32_t nPages = p[0];
+  uint32_t nRects = p[1];
+  if(nRects > (e->size / sizeof(uint32_t) - 2) / 5 || nPages > index.size())
+    return true;
+
+  pages.resize(nPages);
+  for(uint32_t i = 0; i != nPages; ++i)
+    if(image(pages[i], pageName(name, i)))
+      return true;
+
+  p += 2;
+  rects.resize(nRects);
+  for(uint32_t i = 0; i != nRects; ++i, p += 5)
+  {
+    rects[i].page = p[0];
+    rects[i].x = p[1];
+    rects[i].y = p[2];
+    rects[i].w = p[3];
+    rects[i].h = p[4];
+    if(p[0] >= nPages) return true;
+  }
+
+  return false;
+}
+
+
+
+/*
+ * Writer
+ */
+
+void
+PackWriter::pairs(const string& name, const string_map& sm)
+{
+  Item item;
+  memset(&item.e, 0, sizeof(item.e));
+  item.e.type = typePairs;
+  item.name = name;
+
+  for(string_map::const_iterator it = sm.begin(); it != sm.end(); ++it)
+  {
+    item.data.insert(item.data.end(), it->first.begin(), it->first.end());
+    item.data.push_back(0);
+    item.data.insert(item.data.end(), it->second.begin(), it->second.end());
+    item.data.push_back(0);
+  }
+
+  items.push_back(item);
+}
+
+
+void
+PackWriter::image(const string& name, const Image& img)
+{
+  Item item;
+  memset(&item.e, 0, sizeof(item.e));
+  item.e.type = typeImage;
+  item.e.w = img.w;
+  item.e.h = img.h;
+  item.e.chans = img.chans;
+  item.name = name;
+
+  Image pad;
+  padPow2(pad, img);
+  item.e.tw = pad.w;
+  item.e.th = pad.h;
+  item.data.assign(pad.px.begin(), pad.px.end());
+
+  items.push_back(item);
+}
+
+
+void
+PackWriter::atlas(const string& name, const vector<Image>& pages,
+    const vector<AtlasRect>& rects)
+{
+  for(size_t i = 0; i != pages.size(); ++i)
+    image(pageName(name, i), pages[i]);
+
+  vector<uint32_t> buf;
+  buf.push_back(pages.size());
+  buf.push_back(rects.size());
+  for(size_t i = 0; i != rects.size(); ++i)
+  {
+    buf.push_back(rects[i].page);
+    buf.push_back(rects[i].x);
+    buf.push_back(rects[i].y);
+    buf.push_back(rects[i].w);
+    buf.push_back(rects[i].h);
+  }
+
+  Item item;
+  memset(&item.e, 0, sizeof(item.e));
+  item.e.type = typeAtlas;
+  item.name = name;
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(&buf[0]);
+  item.data.assign(p, p + buf.size() * sizeof(uint32_t));
+  items.push_back(item);
+}
+
+
+bool
+PackWriter::write(const char* file) const
+{
+  // layout: header, directory, names, then aligned data
+  PackHeader hdr;
+  memcpy(hdr.magic, packMagic, 4);
+  hdr.version = packVersion;
+  hdr.count = items.size();
+  hdr.reserved = 0;
+
+  vector<PackEntry> dir(items.size());
+  uint64_t off = sizeof(hdr) + dir.size() * sizeof(PackEntry);
+  for(size_t i = 0; i != items.size(); ++i)
+  {
+    dir[i] = items[i].e;
+    dir[i].nameOff = off;
+    dir[i].nameLen = items[i].name.size();
+    off += items[i].name.size();
+  }
+  for(size_t i = 0; i != items.size(); ++i)
+  {
+    off = (off + packAlign - 1) & ~static_cast<uint64_t>(packAlign - 1);
+    dir[i].off = off;
+    dir[i].size = items[i].data.size();
+    off += items[i].data.size();
+  }
+
+  FILE* fd = fopen(file, "wb");
+  if(!fd) return true;
+  bool ret = (fwrite(&hdr, sizeof(hdr), 1, fd) != 1);
+  if(dir.size())
+    ret |= (fwrite(&dir[0], sizeof(PackEntry), dir.size(), fd) != dir.size());
+  for(size_t i = 0; i != items.size(); ++i)
+    ret |= (fwrite(items[i].name.data(), 1, items[i].name.size(), fd)
+	!= items[i].name.size());
+  for(size_t i = 0; i != items.size(); ++i)
+  {
+    static const char zero[packAlign] = {0};
+    long pos = ftell(fd);
+    if(static_cast<uint64_t>(pos) < dir[i].off)
+      ret |= (fwrite(zero, 1, dir[i].off - pos, fd) != dir[i].off - pos);
+    if(items[i].data.size())
+      ret |= (fwrite(&items[i].data[0], 1, items[i].data.size(), fd)
+	  != items[i].data.size());
+  }
+
+  return (fclose(fd) || ret);
+}
+
+
+
+/*
+ * Utilities
+ */
+
+bool
+loadSpriteSizes(Level& data, const Pack& pack)
+{
+  PackImage back;
+  vector<PackImage> pages;
+  vector<AtlasRect> rects;
+  vector<Sprite*> sprites;
+  vector<string> files;
+  levelSprites(data, sprites, files);
+  if(pack.image(back, backFile(data)) || pack.atlas(pages, rects, data.name)
+  || rects.size() != sprites.size())
+    return true;
+
+  data.back.w = back.w;
+  data.back.h = back.h;
+  for(size_t i = 0; i != sprites.size(); ++i)
+  {
+    sprites[i]->w = rects[i].w;
+    sprites[i]->h = rects[i].h;
+  }
+  return false;
+}
+
+
+bool
+loadLevelData(Level& data, const char* dataDir, const Pack* pack,
+    const string& name)
+{
+  string_map sm(data.arena());
+  if(pack? (pack->pairs(sm, name) || loadLevel(data, sm)):
+      loadLevel(data, (string(dataDir) + "/" + name).c_str()))
+    return true;
+  data.name = name;
+  return false;
+}
@@ -0,0 +1,114 @@
+/*
+ * regame: recycling game - preprocessed asset packs
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef pack_hh
+#define pack_hh
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+#include "atlas.hh"
+
+#include <stdint.h>
+#include <utility>
+using std::pair;
+
+
+/*
+ * Structures
+ */
+
+// on-disk directory entry (native byte order)
+struct PackEntry
+{
+  uint32_t type;
+  uint32_t nameOff;
+  uint32_t nameLen;
+  uint32_t w, h, chans;
+  uint32_t tw, th;
+  uint64_t off;
+  uint64_t size;
+};
+
+
+// w x h pixels of a tw x th buffer, edges clamped up to the power of two
+struct PackImage
+{
+  int w, h, chans;
+  int tw, th;
+  const unsigned char* px;
+};
+
+
+/*
+ * Read-only asset pack, mapped in memory: images are handed out as pointers
+ * into the mapping.
+ */
+
+class Pack
+{
+  const unsigned char* base;
+  size_t size;
+  bool mapped;
+  typedef pair<uint32_t, string> Key;	// type, name
+  map<Key, const PackEntry*> index;
+
+  const PackEntry* find(const string& name, uint32_t type) const;
+  void close();
+
+public:
+  Pack();
+  ~Pack();
+
+  // returns true on error
+  bool open(const char* file);
+  bool pairs(string_map& sm, const string& name) const;
+  bool image(PackImage& img, const string& name) const;
+  bool atlas(vector<PackImage>& pages, vector<AtlasRect>& rects,
+      const string& name) const;
+};
+
+
+class PackWriter
+{
+  struct Item
+  {
+    PackEntry e;
+    string name;
+    vector<unsigned char> data;
+  };
+
+  vector<Item> items;
+
+public:
+  void pairs(const string& name, const string_map& sm);
+
+  // padded to powers of two
+  void image(const string& name, const Image& img);
+  void atlas(const string& name, const vector<Image>& pages,
+      const vector<AtlasRect>& rects);
+
+  // returns true on error
+  bool write(const char* file) const;
+};
+
+
+/*
+ * Utilities
+ */
+
+// geometry only, as loadSpriteSizes(data, dataDir): returns true on error
+bool
+loadSpriteSizes(Level& data, const Pack& pack);
+
+// level by name, preprocessed or not: returns true on error
+bool
+loadLevelData(Level& data, const char* dataDir, const Pack* pack,
+    const string& name);
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * regame: recycling game - asset pack builder
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "pack.hh"
+#include "loader.hh"
+
+#include <set>
+using std::set;
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+
+/*
+ * Constants
+ */
+
+namespace
+{
+  const char gameData[] = "game.txt";
+  const char gamePack[] = "game.pak";
+}
+
+
+/*
+ * Utilities
+ */
+
+void
+usage(const char* prg)
+{
+  fprintf(stderr, "usage: %s [-d dir] [-o file]\n"
+      "  -d dir\tgame data directory (.)\n"
+      "  -o file\toutput pack (dir/%s)\n", prg, gamePack);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  string dataDir = ".";
+  string out;
+
+  int c;
+  while((c = getopt(argc, argv, "d:o:h")) != -1)
+  {
+    switch(c)
+    {
+    case 'd': dataDir = optarg; break;
+    case 'o': out = optarg; break;
+    default:
+      usage(argv[0]);
+      return (c == 'h'? EXIT_SUCCESS: EXIT_FAILURE);
+    }
+  }
+  if(!out.size()) out = dataDir + "/" + gamePack;
+
+  string buf = dataDir + "/" + gameData;
+  string_map sm;
+  if(loadPairs(sm, buf.c_str()))
+  {
+    fprintf(stderr, "%s: cannot load game data from %s\n", argv[0], buf.c_str());
+    return EXIT_FAILURE;
+  }
+
+  PackWriter pack;
+  pack.pairs(gameData, sm);
+
+  Decoder decoder;
+  vector<Asset> assets;
+  set<string> images;
+  for(int i = 0;; ++i)
+  {
+    string_map::const_iterator st = sm.find(numbered("level", i));
+    if(st == sm.end()) break;
+    buf = dataDir + "/" + st->second;
+
+    // level parameters
+    string_map lsm;
+    Level data;
+    if(loadPairs(lsm, buf.c_str()) || loadLevel(data, lsm))
+    {
+      fprintf(stderr, "%s: cannot load level %d from %s\n", argv[0], i, buf.c_str());
+      return EXIT_FAILURE;
+    }
+    pack.pairs(st->second, lsm);
+
+    // background and atlas sprites
+    vector<Sprite*> sprites;
+    vector<string> files;
+    files.push_back(backFile(data));
+    levelSprites(data, sprites, files);
+
+    assets.resize(files.size());
+    for(size_t n = 0; n != files.size(); ++n)
+    {
+      assets[n].file = dataDir + "/" + files[n];
+      assets[n].alpha = (n != 0);
+    }
+    decoder.decode(assets);
+
+    vector<const Image*> imgs;
+    for(size_t n = 0; n != assets.size(); ++n)
+    {
+      if(assets[n].failed)
+      {
+	fprintf(stderr, "%s: cannot load %s\n", argv[0], assets[n].file.c_str());
+	return EXIT_FAILURE;
+      }
+      if(n) imgs.push_back(&assets[n].img);
+    }
+
+    if(images.insert(files[0]).second)
+      pack.image(files[0], assets[0].img);
+
+    vector<Image> pages;
+    vector<AtlasRect> rects;
+    if(packAtlas(pages, rects, imgs, atlasPackSize, atlasPad, true))
+    {
+      fprintf(stderr, "%s: level %d sprites do not fit a %dx%d atlas\n",
+	  argv[0], i, atlasPackSize, atlasPackSize);
+      return EXIT_FAILURE;
+    }
+    pack.atlas(st->second, pages, rects);
+
+    printf("%s: %d sprites in %d atlas page(s)\n", st->second.c_str(),
+	static_cast<int>(rects.size()), static_cast<int>(pages.size()));
+  }
+
+  if(pack.write(out.c_str()))
+  {
+    fprintf(stderr, "%s: cannot write %s\n", argv[0], out.c_str());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+/*
+ * regame: recycling game - particle storage
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "pool.hh"
+
+
+/*
+ * Constants
+ */
+
+namespace
+{
+  const int slotBits = 24;
+  const unsigned int slotMask = (1U << slotBits) - 1;
+}
+
+
+/*
+ * Implementation
+ */
+
+void
+ParticlePool::reserve(size_t n)
+{
+  x.reserve(n);
+  y.reserve(n);
+  sy.reserve(n);
+  grabbed.reserve(n);
+  prevY.reserve(n);
+  maxSpeed.reserve(n);
+  type.reserve(n);
+  rand.reserve(n);
+  id.reserve(n);
+  slotIndex.reserve(n);
+  slotGen.reserve(n);
+  freeSlots.reserve(n);
+}
+
+
+void
+ParticlePool::clear()
+{
+  // invalidate all outstanding handles
+  for(size_t i = 0; i != id.size(); ++i)
+  {
+    unsigned int slot = id[i] & slotMask;
+    ++slotGen[slot];
+    freeSlots.push_back(slot);
+  }
+
+  x.clear();
+  y.clear();
+  sy.clear();
+  grabbed.clear();
+  prevY.clear();
+  maxSpeed.clear();
+  type.clear();
+  rand.clear();
+  id.clear();
+}
+
+
+ParticleId
+ParticlePool::add(float px, float py, float psy, ObjType ptype,
+    bool pgrabbed, float pmaxSpeed, int prand)
+{
+  unsigned int slot;
+  if(freeSlots.size())
+  {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+  }
+  else
+  {
+    slot = slotIndex.size();
+    slotIndex.push_back(0);
+    slotGen.push_back(0);
+  }
+
+  ParticleId p = slot | (slotGen[slot] << slotBits);
+  slotIndex[slot] = y.size();
+
+  x.push_back(px);
+  y.push_back(py);
+  sy.push_back(psy);
+  grabbed.push_back(pgrabbed);
+  prevY.push_back(py);
+  maxSpeed.push_back(pmaxSpeed);
+  type.push_back(ptype);
+  rand.push_back(prand);
+  id.push_back(p);
+
+  return p;
+}
+
+
+void
+ParticlePool::remove(size_t i)
+{
+  unsigned int slot = id[i] & slotMask;
+  ++slotGen[slot];
+  freeSlots.push_back(slot);
+
+  size_t last = y.size() - 1;
+  if(i != last)
+  {
+    x[i] = x[last];
+    y[i] = y[last];
+    sy[i] = sy[last];
+    grabbed[i] = grabbed[last];
+    prevY[i] = prevY[last];
+    maxSpeed[i] = maxSpeed[last];
+    type[i] = type[last];
+    rand[i] = rand[last];
+    id[i] = id[last];
+    slotIndex[id[i] & slotMask] = i;
+  }
+
+  x.pop_back();
+  y.pop_back();
+  sy.pop_back();
+  grabbed.pop_back();
+  prevY.pop_back();
+  maxSpeed.pop_back();
+  type.pop_back();
+  rand.pop_back();
+  id.pop_back();
+}
+
+
+ptrdiff_t
+ParticlePool::index(ParticleId p) const
+{
+  // generations wrap around in the handle bits
+  unsigned int slot = p & slotMask;
+  if(slot >= slotGen.size() || (slotGen[slot] << slotBits) != (p & ~slotMask))
+    return -1;
+  return slotIndex[slot];
+}
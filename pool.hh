@@ -0,0 +1,74 @@
+/*
+ * regame: recycling game - particle storage
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef pool_hh
+#define pool_hh
+
+/*
+ * Headers
+ */
+
+#include <vector>
+using std::vector;
+
+#include <stddef.h>
+
+
+/*
+ * Structures
+ */
+
+typedef int ObjType;
+
+// stable particle handle: slot index in the low bits, slot generation on top
+typedef unsigned int ParticleId;
+
+
+/*
+ * Particle pool: particles are kept as a structure of arrays, densely packed
+ * so that the physics loop only touches the hot fields. Removal moves the last
+ * particle into the hole (order is not preserved); use handles to refer to a
+ * particle across removals.
+ */
+
+class ParticlePool
+{
+  // handle slots
+  vector<unsigned int> slotIndex;
+  vector<unsigned int> slotGen;
+  vector<unsigned int> freeSlots;
+
+public:
+  // hot: touched every step
+  vector<float> x;
+  vector<float> y;
+  vector<float> sy;
+  vector<int> grabbed;
+
+  // cold
+  vector<float> prevY;	// y before the last step (interpolation)
+  vector<float> maxSpeed;
+  vector<ObjType> type;
+  vector<int> rand;
+  vector<ParticleId> id;
+
+  size_t size() const
+  { return y.size(); }
+
+  void reserve(size_t n);
+  void clear();
+
+  ParticleId add(float x, float y, float sy, ObjType type,
+      bool grabbed, float maxSpeed, int rand);
+
+  // swap-and-pop the particle at dense index i
+  void remove(size_t i);
+
+  // dense index of the particle, or -1 if it's gone
+  ptrdiff_t index(ParticleId p) const;
+};
+
+#endif
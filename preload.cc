@@ -0,0 +1,79 @@
+/*
+ * regame: recycling game - level preloading
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "preload.hh"
+#include "profile.hh"
+
+
+/*
+ * Implementation
+ */
+
+Preloader::Preloader()
+: decoder(1), level(NULL), failed(false)
+{}
+
+
+Preloader::~Preloader()
+{
+  delete take();
+}
+
+
+void
+Preloader::run(const char* dataDir, const Pack* pack, string name)
+{
+  failed = prepareLevel(*level, dataDir, pack, name, decoder);
+}
+
+
+void
+Preloader::start(const char* dataDir, const Pack* pack, const string& name)
+{
+  delete take();
+  level = new PreparedLevel;
+  thread = std::thread(&Preloader::run, this, dataDir, pack, name);
+}
+
+
+PreparedLevel*
+Preloader::take()
+{
+  if(thread.joinable()) thread.join();
+  PreparedLevel* ret = level;
+  level = NULL;
+  if(failed)
+  {
+    delete ret;
+    ret = NULL;
+  }
+  failed = false;
+  return ret;
+}
+
+
+
+/*
+ * Utilities
+ */
+
+bool
+prepareLevel(PreparedLevel& level, const char* dataDir, const Pack* pack,
+    const string& name, Decoder& decoder)
+{
+  ScopedTimer t(level.time);
+  if(loadLevelData(level.data, dataDir, pack, name)
+  || (pack? loadSpriteSizes(level.data, *pack):
+	  loadSpriteSizes(level.data, dataDir)))
+    return true;
+
+  if(!pack) decodeLevel(level.assets, level.data, dataDir, decoder);
+  return false;
+}
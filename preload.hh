@@ -0,0 +1,75 @@
+/*
+ * regame: recycling game - level preloading
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef preload_hh
+#define preload_hh
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+#include "loader.hh"
+#include "pack.hh"
+
+#include <thread>
+
+
+/*
+ * Structures
+ */
+
+// a level ready to be uploaded and played: everything in its own arena
+struct PreparedLevel
+{
+  Arena arena;
+  Level data;
+  vector<Asset> assets;	// as decodeLevel(), none when packed
+  double time;		// msecs spent preparing
+
+  PreparedLevel()
+  : data(&arena), time(0)
+  {}
+};
+
+
+/*
+ * Prepares the next level on its own thread while the current one is being
+ * played, decoding on a single core so as not to slow the game down.
+ */
+
+class Preloader
+{
+  Decoder decoder;
+  std::thread thread;
+  PreparedLevel* level;
+  bool failed;
+
+  void run(const char* dataDir, const Pack* pack, string name);
+
+public:
+  Preloader();
+  ~Preloader();
+
+  // start preparing a level, dropping any other
+  void start(const char* dataDir, const Pack* pack, const string& name);
+
+  // wait for it: the caller owns the result (NULL on error or if none)
+  PreparedLevel* take();
+};
+
+
+/*
+ * Utilities
+ */
+
+// the parameters, sprite sizes and (unless packed) the decoded images of a
+// level: returns true on error (images failing to decode are not)
+bool
+prepareLevel(PreparedLevel& level, const char* dataDir, const Pack* pack,
+    const string& name, Decoder& decoder);
+
+#endif
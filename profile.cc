@@ -0,0 +1,112 @@
+/*
+ * regame: recycling game - frame profiling
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "profile.hh"
+#include "alloc.hh"
+
+#include <string.h>
+
+#include <algorithm>
+
+
+/*
+ * Implementation
+ */
+
+Profiler::Profiler(size_t window)
+: ring(window), frames(0), last(0), lastAllocs(allocations()), csv(NULL),
+  steadyAllocs(lastAllocs < 0? -1: 0)
+{
+  scratch.reserve(window);
+  memset(&cur, 0, sizeof(cur));
+}
+
+
+Profiler::~Profiler()
+{
+  if(csv) fclose(csv);
+}
+
+
+bool
+Profiler::openCsv(const char* file)
+{
+  if(csv) fclose(csv);
+  csv = fopen(file, "w");
+  if(!csv) return true;
+
+  fprintf(csv, "frame,frame_ms,update_ms,draw_ms,late_ms,steps,missed,"
+      "particles,draw_calls,touched,allocs\n");
+  return false;
+}
+
+
+void
+Profiler::frame()
+{
+  double now = monotonic();
+  long allocs = allocations();
+  if(last)
+  {
+    cur.frame = (now - last) * 1e3;
+    cur.allocs = (allocs < 0? -1: allocs - lastAllocs);
+    if(allocs >= 0 && frames >= warmup) steadyAllocs += cur.allocs;
+    ring[frames % ring.size()] = cur;
+    if(csv)
+    {
+      fprintf(csv, "%lu,%.3f,%.3f,%.3f,%.3f,%d,%d,%d,%d,%.4f,%ld\n",
+	  static_cast<unsigned long>(frames), cur.frame, cur.update, cur.draw,
+	  cur.late, cur.steps, cur.missed, cur.particles, cur.drawCalls,
+	  cur.touched, cur.allocs);
+    }
+    ++frames;
+  }
+
+  last = now;
+  lastAllocs = allocs;
+  memset(&cur, 0, sizeof(cur));
+}
+
+
+double
+Profiler::average(double FrameStats::* field) const
+{
+  size_t n = size();
+  double sum = 0;
+  for(size_t i = 0; i != n; ++i)
+    sum += ring[i].*field;
+  return (n? sum / n: 0);
+}
+
+
+double
+Profiler::maximum(double FrameStats::* field) const
+{
+  double m = 0;
+  for(size_t i = 0; i != size(); ++i)
+    if(ring[i].*field > m) m = ring[i].*field;
+  return m;
+}
+
+
+double
+Profiler::percentile(double FrameStats::* field, double p) const
+{
+  size_t n = size();
+  if(!n) return 0;
+
+  scratch.resize(n);
+  for(size_t i = 0; i != n; ++i)
+    scratch[i] = ring[i].*field;
+
+  size_t k = static_cast<size_t>(p / 100. * (n - 1) + 0.5);
+  std::nth_element(scratch.begin(), scratch.begin() + k, scratch.end());
+  return scratch[k];
+}
@@ -0,0 +1,105 @@
+/*
+ * regame: recycling game - frame profiling
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef profile_hh
+#define profile_hh
+
+/*
+ * Headers
+ */
+
+#include "timing.hh"
+
+#include <vector>
+using std::vector;
+
+#include <stdio.h>
+
+
+/*
+ * Structures
+ */
+
+// one frame, from the start of a draw to the next (times in msecs)
+struct FrameStats
+{
+  double frame;		// since the previous frame
+  double update;	// spent stepping the simulation since the last frame
+  double draw;		// spent issuing GL calls
+  double late;		// simulation wake-up past its deadline
+  int steps;
+  int missed;		// frames skipped by the pacer before this one
+  int particles;
+  int drawCalls;
+  double touched;	// fraction of the pixels redrawn
+  long allocs;		// heap allocations since the previous frame, or -1
+};
+
+
+// adds the elapsed msecs to a counter when leaving the scope
+class ScopedTimer
+{
+  double& acc;
+  double start;
+
+public:
+  ScopedTimer(double& acc)
+  : acc(acc), start(monotonic())
+  {}
+
+  ~ScopedTimer()
+  { acc += (monotonic() - start) * 1e3; }
+};
+
+
+/*
+ * Keeps the last frames in a ring for the summary statistics, optionally
+ * dumping every frame to a CSV file. Heap allocations are counted on all
+ * threads when built for it: past the first warmup frames there should be
+ * none.
+ */
+
+class Profiler
+{
+  vector<FrameStats> ring;
+  size_t frames;
+  double last;
+  long lastAllocs;
+  FILE* csv;
+  mutable vector<double> scratch;
+
+public:
+  enum { warmup = 120 };
+
+  // the frame being measured
+  FrameStats cur;
+
+  // heap allocations after the warmup, -1 if not counted
+  long steadyAllocs;
+
+  Profiler(size_t window = 256);
+  ~Profiler();
+
+  // returns true on error
+  bool openCsv(const char* file);
+
+  // close the current frame and start the next one
+  void frame();
+
+  // over the frames in the ring
+  size_t size() const
+  { return (frames < ring.size()? frames: ring.size()); }
+
+  // the last one closed
+  const FrameStats& previous() const
+  { return ring[(frames + ring.size() - 1) % ring.size()]; }
+
+  double average(double FrameStats::* field) const;
+  double maximum(double FrameStats::* field) const;
+  double percentile(double FrameStats::* field, double p) const;
+};
+
+#endif
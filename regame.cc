@@ -11,123 +11,61 @@
 // GUI
 #include <FL/Fl.H>
 #include <FL/Fl_Gl_Window.H>
+#include <FL/Fl_Double_Window.H>
 #include <FL/fl_ask.H>
+#include <FL/fl_draw.H>
 #include <FL/filename.H>
 #include "score.hh"
+#include "world.hh"
+#include "render.hh"
+#include "soft.hh"
 
 // graphics
-#include <png.h>
+#include "atlas.hh"
+#include "loader.hh"
+#include "pack.hh"
+#include "preload.hh"
+#include "profile.hh"
+#include "scene.hh"
+#include "sim.hh"
+#include "texcache.hh"
+#include "timing.hh"
+#include "text.hh"
 #include <FL/gl.h>
 #include <FL/glu.h>
-#include <FL/fl_draw.H>
 
 #ifdef __APPLE__
 #include <Carbon/Carbon.h>
+#include <OpenGL/OpenGL.h>
+#elif !defined(WIN32)
+#include <FL/x.H>
+#include <GL/glx.h>
 #endif
 
 // poor man's gl_ext
 #ifndef GL_TEXTURE_RECTANGLE_ARB
 #define GL_TEXTURE_RECTANGLE_ARB 0x84F5
 #endif
+#ifndef GL_MAX_RECTANGLE_TEXTURE_SIZE_ARB
+#define GL_MAX_RECTANGLE_TEXTURE_SIZE_ARB 0x84F8
+#endif
+#ifndef GLX_BACK_BUFFER_AGE_EXT
+#define GLX_BACK_BUFFER_AGE_EXT 0x20F4
+#endif
 
 // base libs
-#include <vector>
-using std::vector;
-
-#include <string>
-using std::string;
-
-#include <map>
-using std::map;
-
-#include <fstream>
-using std::ifstream;
-
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <ctype.h>
 #include <math.h>
 #include <string.h>
 #include <fenv.h>
+#include <limits.h>
+#include <time.h>
 
-// time
-#if (defined(__MINGW32__) && __GNUG__ > 3) || !defined(WIN32)
-#include <sys/time.h>
-#else
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#endif
-
-
-/*
- * Structures
- */
-
-typedef map<string, string> string_map;
-typedef int ObjType;
-
-struct Point2f
-{
-  Point2f()
-  {}
-
-  Point2f(float x, float y)
-  : x(x), y(y)
-  {}
-
-  float x;
-  float y;
-};
-
-
-struct Sprite
-{
-  GLuint tex;
-  int w, h;
-  float rw, rh;
-};
-
-
-struct PointAcc2f: public Point2f
-{
-  PointAcc2f()
-  {}
-
-  PointAcc2f(float x, float y, float sx, float sy)
-  : Point2f(x, y), sx(sx), sy(sy)
-  {}
-
-  float sx;
-  float sy;
-};
-
-
-struct Container
-{
-  ObjType accept;
-  Point2f pos;
-  Sprite s;
-  Point2f accWin[2];
-  int shakeStart;
-};
-
-
-struct Particle: public PointAcc2f
-{
-  Particle()
-  {}
-
-  Particle(float x, float y, float sx, float sy)
-  : PointAcc2f(x, y, sx, sy)
-  {}
-
-  ObjType type;
-  bool grabbed;
-  float maxSpeed;
-  int rand;
-};
-
+#include <utility>
 
 
 /*
@@ -137,14 +75,27 @@ struct Particle: public PointAcc2f
 namespace
 {
   const char gameData[] = "game.txt";
-  const float refms = 1. / 60.;
+  const char gamePack[] = "game.pak";
+  const double paceSlack = 0.002;	// secs the frame timer may be late by
   const float popupTime = 2.;
   const Fl_Font font = FL_HELVETICA_BOLD;
   const int fontSize = 24;
   const int fontSpc = 2;
-  const int startLives = 3;
   const char scoreUrl[] = "http://www.develer.com/~wavexx/regame/score?magic=";
   GLenum target = GL_TEXTURE_RECTANGLE_ARB;
+  bool stats = false;
+  bool timing = false;
+  int step = 4;			// simulation step, in msecs
+  const char* recordFile = NULL;
+  const char* profileFile = NULL;
+  bool autopilot = false;
+  float speed = 1;		// simulated time per real time
+  double refresh = 60;		// frames per second
+  bool swapSync = false;	// also sync the buffer swaps to the display
+  bool damageMode = false;	// redraw only what changed
+  bool software = false;	// draw on the CPU instead of through GL
+  const Fl_Font profFont = FL_COURIER;
+  const int profFontSize = 12;
 }
 
 
@@ -153,30 +104,6 @@ namespace
  */
 
 
-#ifdef WIN32_LEAN_AND_MEAN
-int
-gettimeofday(struct timeval* tv, struct timezone*)
-{
-  LARGE_INTEGER n;
-  LARGE_INTEGER freq;
-  QueryPerformanceCounter(&n);
-  QueryPerformanceFrequency(&freq);
-  tv->tv_sec = (long)(static_cast<double>(n.QuadPart) / freq.QuadPart);
-  tv->tv_usec = (long)((static_cast<double>(n.QuadPart) / freq.QuadPart
-	  - tv->tv_sec) * 1000000);
-  return 0;
-}
-#endif
-
-
-long
-tvdiff(const timeval& l, const timeval& r)
-{
-  return ((l.tv_sec * 1000 + l.tv_usec / 1000) -
-      (r.tv_sec * 1000 + r.tv_usec / 1000));
-}
-
-
 const char*
 getResDir()
 {
@@ -199,216 +126,483 @@ getResDir()
 }
 
 
-float
-defaultValue(const string_map& settings,
-    const string& setting, const float def)
+Dir
+kpLR(int key)
 {
-  string_map::const_iterator st = settings.find(setting);
-  return (st == settings.end()? def: atof(st->second.c_str()));
+  switch(key)
+  {
+  case FL_Left:
+  case 'a':
+  case '4' + FL_KP:
+    return dirLeft;
+
+  case FL_Right:
+  case 'd':
+  case '6' + FL_KP:
+    return dirRight;
+  }
+
+  return dirNone;
 }
 
 
-string
-defaultValue(const string_map& settings,
-    const string& setting, const string& def)
+// vertical sync through the platform's swap interval, for the current
+// context: returns true if not available
+bool
+swapInterval(int interval)
 {
-  string_map::const_iterator st = settings.find(setting);
-  return (st == settings.end()? def: st->second);
+#if defined(__APPLE__)
+  GLint v = interval;
+  return (CGLSetParameter(CGLGetCurrentContext(), kCGLCPSwapInterval, &v)
+      != kCGLNoError);
+#elif defined(WIN32)
+  typedef BOOL (WINAPI *SwapProc)(int);
+  SwapProc proc = reinterpret_cast<SwapProc>(
+      wglGetProcAddress("wglSwapIntervalEXT"));
+  return (!proc || !proc(interval));
+#else
+  typedef int (*SwapProc)(int);
+  static const char* const procs[] =
+  {
+    "glXSwapIntervalMESA",
+    "glXSwapIntervalSGI"
+  };
+  for(size_t i = 0; i != sizeof(procs) / sizeof(*procs); ++i)
+  {
+    SwapProc proc = reinterpret_cast<SwapProc>(glXGetProcAddressARB(
+	    reinterpret_cast<const GLubyte*>(procs[i])));
+    if(proc && !proc(interval)) return false;
+  }
+  return true;
+#endif
 }
 
 
+// whether the age of the back buffers can be asked (GLX_EXT_buffer_age)
 bool
-loadPairs(string_map& buf, const char* file)
+bufferAgeQuery()
 {
-  ifstream in(file);
-  if(!in) return true;
+#if defined(__APPLE__) || defined(WIN32)
+  return false;
+#else
+  const char* ext = glXQueryExtensionsString(fl_display, fl_screen);
+  return (ext && strstr(ext, "GLX_EXT_buffer_age"));
+#endif
+}
 
-  string line;
-  while(std::getline(in, line))
-  {
-    // empty lines
-    if(!line.size())
-      continue;
-    if(line[0] == '#')
-      continue;
-
-    string::size_type eq = line.find('=');
-    if(eq == string::npos || eq == 0)
-      return true;
 
-    // insert the new element
-    buf.insert(make_pair(line.substr(0, eq), line.substr(eq + 1)));
-  }
+// frames the back buffer of the current context's window is behind, 0 if
+// its contents are undefined
+int
+bufferAge(Fl_Window* win)
+{
+#if defined(__APPLE__) || defined(WIN32)
+  (void)win;
+  return 0;
+#else
+  unsigned int age = 0;
+  glXQueryDrawable(fl_display, fl_xid(win), GLX_BACK_BUFFER_AGE_EXT, &age);
+  return age;
+#endif
+}
 
-  return false;
+
+// the software renderer's textures are global, as GL's are to the context
+SoftRenderer&
+softRenderer()
+{
+  static SoftRenderer renderer;
+  return renderer;
 }
 
 
-GLfloat*
-parseColor(GLfloat* buf, const char* color)
+void
+deleteTex(unsigned int tex)
 {
-  // parse the value
-  unsigned long v = strtoul((color[0] == '#'? color + 1: color), NULL, 16);
+  if(software) softRenderer().release(tex);
+  else glDeleteTextures(1, &tex);
+}
 
-  // separate the components
-  buf[0] = static_cast<float>((v >> 16) & 0xFF) / 255.;
-  buf[1] = static_cast<float>((v >> 8) & 0xFF) / 255.;
-  buf[2] = static_cast<float>((v) & 0xFF) / 255.;
 
-  return buf;
+// textures are shared by the levels (and views) in turn
+TextureCache&
+textureCache()
+{
+  static TextureCache cache(deleteTex);
+  return cache;
 }
 
 
-int
-kpLR(int key)
+// memory taken by a w x h texture, as uploaded
+size_t
+texBytes(int w, int h, int chans)
 {
-  switch(key)
+  if(software) return w * h * 4;
+  if(target == GL_TEXTURE_2D)
   {
-  case FL_Left:
-  case 'a':
-  case '4' + FL_KP:
-    return FL_Left;
+    w = nextPower(w);
+    h = nextPower(h);
+  }
+  return w * h * chans;
+}
 
-  case FL_Right:
-  case 'd':
-  case '6' + FL_KP:
-    return FL_Right;
+
+// upload w x h pixels out of a tw x th buffer
+bool
+uploadTex(Sprite& sprite, const unsigned char* px, int w, int h, int chans,
+    int tw, int th)
+{
+  GLenum f = (chans == 4? GL_RGBA: GL_RGB);
+  sprite.w = w;
+  sprite.h = h;
+  sprite.u0 = sprite.v0 = 0;
+  if(software)
+  {
+    sprite.tex = softRenderer().upload(px, w, h, chans, tw);
+    sprite.u1 = sprite.w;
+    sprite.v1 = sprite.h;
+    return false;
   }
 
-  return 0;
+  glGenTextures(1, &sprite.tex);
+  glBindTexture(target, sprite.tex);
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if(target == GL_TEXTURE_RECTANGLE_ARB)
+  {
+    sprite.u1 = sprite.w;
+    sprite.v1 = sprite.h;
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, tw);
+    glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, f, sprite.w, sprite.h,
+	0, f, GL_UNSIGNED_BYTE, px);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  }
+  else if(tw == nextPower(w) && th == nextPower(h))
+  {
+    // already padded
+    sprite.u1 = static_cast<float>(sprite.w) / tw;
+    sprite.v1 = static_cast<float>(sprite.h) / th;
+    glTexImage2D(GL_TEXTURE_2D, 0, f, tw, th, 0, f, GL_UNSIGNED_BYTE, px);
+  }
+  else
+  {
+    // copy to an aligned buffer
+    Image src, pad;
+    src.w = tw;
+    src.h = th;
+    src.chans = chans;
+    src.px.assign(px, px + tw * th * chans);
+    if(tw != w || th != h)
+    {
+      // crop first
+      for(int y = 0; y != h; ++y)
+	memmove(&src.px[y * w * chans], &src.px[y * tw * chans], w * chans);
+      src.w = w;
+      src.h = h;
+    }
+    padPow2(pad, src);
+    sprite.u1 = static_cast<float>(sprite.w) / pad.w;
+    sprite.v1 = static_cast<float>(sprite.h) / pad.h;
+    glTexImage2D(GL_TEXTURE_2D, 0, f, pad.w, pad.h, 0, f, GL_UNSIGNED_BYTE,
+	&pad.px[0]);
+  }
+
+  return false;
 }
 
 
-int nextPower(int i)
+bool
+uploadTex(Sprite& sprite, const Image& img)
 {
-  int r = 1;
-  while((r <<= 1) < i);
-  return r;
+  return uploadTex(sprite, &img.px[0], img.w, img.h, img.chans, img.w, img.h);
 }
 
 
-bool
-loadTex(Sprite& sprite, const char* file, bool alpha)
+Decoder&
+decoder()
+{
+  static Decoder pool;
+  return pool;
+}
+
+
+GLint
+maxTexSize()
 {
-  FILE* fd = fopen(file, "rb");
-  if(!fd) return true;
+  if(software) return SoftRenderer::maxSize;
+  GLint maxSize;
+  glGetIntegerv((target == GL_TEXTURE_RECTANGLE_ARB?
+	  GL_MAX_RECTANGLE_TEXTURE_SIZE_ARB: GL_MAX_TEXTURE_SIZE), &maxSize);
+  return maxSize;
+}
 
-  png_structp png_ptr = png_create_read_struct(
-      PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-  if(!png_ptr) return true;
 
-  png_infop info_ptr = png_create_info_struct(png_ptr);
-  if(!info_ptr)
+// the textures go to the cache, if any, for the sprites to be inserted
+void
+loadAtlas(const vector<Sprite*>& sprites, const vector<const Image*>& imgs,
+    TextureCache* cache = NULL)
+{
+  double start = monotonic();
+  vector<Image> pages;
+  vector<AtlasRect> rects;
+  if(packAtlas(pages, rects, imgs, maxTexSize(), atlasPad,
+	  target == GL_TEXTURE_2D))
   {
-    png_destroy_read_struct(&png_ptr, NULL, NULL);
-    return true;
+    // some sprite is just too big: fallback to one texture each
+    for(size_t i = 0; i != imgs.size(); ++i)
+    {
+      if(!imgs[i]->w) continue;
+      uploadTex(*sprites[i], *imgs[i]);
+      if(cache)
+	cache->add(sprites[i]->tex,
+	    texBytes(imgs[i]->w, imgs[i]->h, imgs[i]->chans));
+    }
+    return;
   }
+  double packed = monotonic();
 
-  png_infop end_info = png_create_info_struct(png_ptr);
-  if(!end_info)
+  vector<Sprite> tex(pages.size());
+  for(size_t i = 0; i != pages.size(); ++i)
   {
-    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-    return true;
+    uploadTex(tex[i], pages[i]);
+    if(cache)
+      cache->add(tex[i].tex, texBytes(pages[i].w, pages[i].h, pages[i].chans));
   }
+  if(timing)
+  {
+    fprintf(stderr, "atlas: %d page(s), pack %.2f ms, upload %.2f ms\n",
+	static_cast<int>(pages.size()), (packed - start) * 1e3,
+	(monotonic() - packed) * 1e3);
+  }
+
+  assignAtlas(sprites, tex, rects);
+}
 
-  char* buf = NULL;
-  char** rows = NULL;
 
-  png_init_io(png_ptr, fd);
-  if(setjmp(png_jmpbuf(png_ptr)))
+// the sprites out of the cache, packing the others into new pages: their
+// keys are held (until released) in held
+void
+loadCached(const vector<Sprite*>& sprites, const vector<const Image*>& imgs,
+    const vector<string>& keys, vector<string>& held)
+{
+  TextureCache& cache = textureCache();
+  vector<Sprite*> missed;
+  vector<const Image*> missedImgs;
+  vector<string> missedKeys;
+  for(size_t i = 0; i != sprites.size(); ++i)
   {
-    png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
-    fclose(fd);
-    if(buf) delete[] buf;
-    if(rows) delete[] rows;
-    return true;
+    if(!imgs[i]->w) continue;
+    held.push_back(keys[i]);
+    if(cache.acquire(keys[i], *sprites[i]))
+    {
+      missed.push_back(sprites[i]);
+      missedImgs.push_back(imgs[i]);
+      missedKeys.push_back(keys[i]);
+    }
   }
+  if(!missed.size()) return;
 
-  png_read_info(png_ptr, info_ptr);
-  sprite.w = png_get_image_width(png_ptr, info_ptr);
-  sprite.h = png_get_image_height(png_ptr, info_ptr);
-
-  // enforce 8bit RGB/A.
-  png_set_gray_to_rgb(png_ptr);
-  png_set_palette_to_rgb(png_ptr);
-  png_set_expand(png_ptr);
-  png_set_strip_16(png_ptr);
-  if(!alpha) png_set_strip_alpha(png_ptr);
+  loadAtlas(missed, missedImgs, &cache);
+  for(size_t i = 0; i != missed.size(); ++i)
+    cache.insert(missedKeys[i], *missed[i]);
+}
 
-  GLenum f = (alpha? GL_RGBA: GL_RGB);
-  int chans = (alpha? 4: 3);
 
-  buf = new char[sprite.w * sprite.h * chans];
-  rows = new char*[sprite.h];
-  if(!buf || !rows) longjmp(png_jmpbuf(png_ptr), 1);
+// upload straight from the pack mapping, what's not cached: returns true
+// if anything's missing
+bool
+loadPacked(Level& data, const Pack& pack, vector<string>& held)
+{
+  double start = monotonic();
+  vector<Sprite*> sprites;
+  vector<string> files;
+  levelSprites(data, sprites, files);
+
+  PackImage back;
+  vector<PackImage> pages;
+  vector<AtlasRect> rects;
+  if(pack.image(back, backFile(data))
+  || pack.atlas(pages, rects, data.name)
+  || rects.size() != sprites.size())
+    return true;
 
-  for(int y = 0; y != sprite.h; ++y)
-    rows[y] = buf + (sprite.w * y * chans);
+  GLint maxSize = maxTexSize();
+  for(size_t i = 0; i != pages.size(); ++i)
+    if(pages[i].tw > maxSize || pages[i].th > maxSize)
+      return true;
 
-  png_read_image(png_ptr, (png_byte**)rows);
-  png_read_end(png_ptr, end_info);
-  png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
-  fclose(fd);
+  TextureCache& cache = textureCache();
+  string key = "pack:" + backFile(data) + "#rgb";
+  held.push_back(key);
+  if(cache.acquire(key, data.back))
+  {
+    uploadTex(data.back, back.px, back.w, back.h, back.chans, back.tw, back.th);
+    cache.add(data.back.tex, texBytes(back.w, back.h, back.chans));
+    cache.insert(key, data.back);
+  }
 
-  glGenTextures(1, &sprite.tex);
-  glBindTexture(target, sprite.tex);
-  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  if(target == GL_TEXTURE_RECTANGLE_ARB)
+  // the level's pages are uploaded whole if any sprite is missing
+  vector<size_t> missed;
+  size_t first = held.size();
+  for(size_t i = 0; i != sprites.size(); ++i)
   {
-    sprite.rw = sprite.w;
-    sprite.rh = sprite.h;
-    glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, f, sprite.w, sprite.h,
-	0, f, GL_UNSIGNED_BYTE, buf);
+    held.push_back("pack:" + files[i] + "#rgba");
+    if(cache.acquire(held.back(), *sprites[i]))
+      missed.push_back(i);
   }
-  else
+  if(missed.size())
   {
-    int tw = nextPower(sprite.w);
-    int th = nextPower(sprite.h);
-    sprite.rw = static_cast<float>(sprite.w) / tw;
-    sprite.rh = static_cast<float>(sprite.h) / th;
-
-    // copy to an aligned nbuffer
-    char* nbuf = new char[tw * th * chans];
-    for(int y = 0; y != sprite.h; ++y)
-      memcpy(
-	  nbuf + tw * chans * y,
-	  buf + sprite.w * chans * y,
-	  sprite.w * chans);
-
-    // clamp to elimiate bleeding
-    for(int y = 0; y != sprite.h; ++y)
-      for(int x = sprite.w; x != tw; ++x)
-	memcpy(
-	    nbuf + tw * chans * y + x * chans,
-	    nbuf + tw * chans * y + sprite.w * chans - chans,
-	    chans);
-    for(int y = sprite.h; y != th; ++y)
-      memcpy(
-	  nbuf + tw * chans * y,
-	  nbuf + tw * chans * (sprite.h - 1),
-	  tw * chans);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, f, tw, th, 0, f, GL_UNSIGNED_BYTE, nbuf);
-    delete []nbuf;
+    vector<Sprite> tex(pages.size());
+    for(size_t i = 0; i != pages.size(); ++i)
+    {
+      const PackImage& p = pages[i];
+      uploadTex(tex[i], p.px, p.w, p.h, p.chans, p.tw, p.th);
+      cache.add(tex[i].tex, texBytes(p.w, p.h, p.chans));
+    }
+
+    vector<Sprite> placed(sprites.size());
+    vector<Sprite*> dst;
+    for(size_t i = 0; i != placed.size(); ++i)
+      dst.push_back(&placed[i]);
+    assignAtlas(dst, tex, rects);
+    for(size_t i = 0; i != missed.size(); ++i)
+    {
+      size_t n = missed[i];
+      *sprites[n] = placed[n];
+      cache.insert(held[first + n], *sprites[n]);
+    }
   }
 
-  delete[] rows;
-  delete[] buf;
+  if(timing)
+  {
+    fprintf(stderr, "textures: %d page(s) from pack, %d sprite(s) cached, "
+	"upload %.2f ms\n", static_cast<int>(missed.size()? pages.size(): 0),
+	static_cast<int>(sprites.size() - missed.size()),
+	(monotonic() - start) * 1e3);
+  }
   return false;
 }
 
 
+// the metrics of a font, and the size of the image of each glyph
+void
+fontMetrics(GlyphFont& font, vector<Image>& imgs, Fl_Font face, int size)
+{
+  const int count = GlyphFont::last - GlyphFont::first + 1;
+  if(software) fl_font(face, size);
+  else gl_font(face, size);
+  font.height = fl_height();
+  font.descent = fl_descent();
+  font.pad = 1;
+  font.advance.resize(count);
+  font.glyphs.resize(count);
+  imgs.resize(count);
+
+  for(int i = 0; i != count; ++i)
+  {
+    char c = GlyphFont::first + i;
+    font.advance[i] = fl_width(&c, 1);
+    imgs[i].w = static_cast<int>(ceil(font.advance[i])) + 2 * font.pad;
+    imgs[i].h = font.height + 2 * font.pad;
+    imgs[i].chans = 4;
+  }
+}
+
+
+// draw the glyphs of a font with FLTK within vw x vh, in as many passes as
+// needed (into the GL back buffer, or an offscreen pixmap for the software
+// renderer), and read them back as white images with the coverage in alpha:
+// returns true if not even a glyph fits
 bool
-loadTex2(Sprite& sprite, const char* file, bool alpha)
+rasterFont(GlyphFont& font, vector<Image>& imgs, Fl_Font face, int size,
+    int vw, int vh)
 {
-  // loading errors of textures is ignored...
-  if(loadTex(sprite, file, alpha))
+  const int count = GlyphFont::last - GlyphFont::first + 1;
+  fontMetrics(font, imgs, face, size);
+
+  int cw = 0;
+  int ch = font.height + 2 * font.pad;
+  for(int i = 0; i != count; ++i)
+    if(imgs[i].w > cw) cw = imgs[i].w;
+  int cols = vw / cw;
+  int cells = cols * (vh / ch);
+  if(!cells) return true;
+
+  Fl_Offscreen off = 0;
+  if(software)
+    off = fl_create_offscreen(vw, vh);
+  else
   {
-    fprintf(stderr, "cannot load texture %s\n", file);
-    return true;
+    glDisable(target);
+    glDisable(GL_BLEND);
+    glClearColor(0, 0, 0, 1);
+    glColor3f(1, 1, 1);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  }
+
+  // cells from the top left, coverage read back top first
+  vector<unsigned char> px, cover(vw * vh);
+  for(int pass = 0; pass < count; pass += cells)
+  {
+    int end = (pass + cells < count? pass + cells: count);
+    if(software)
+    {
+      fl_begin_offscreen(off);
+      fl_color(FL_BLACK);
+      fl_rectf(0, 0, vw, vh);
+      fl_color(FL_WHITE);
+      for(int i = pass; i != end; ++i)
+      {
+	char c = GlyphFont::first + i;
+	int n = i - pass;
+	fl_draw(&c, 1, (n % cols) * cw + font.pad,
+	    (n / cols + 1) * ch - font.pad - font.descent);
+      }
+      px.resize(vw * vh * 3);
+      fl_read_image(&px[0], 0, 0, vw, vh);
+      fl_end_offscreen();
+      for(int i = 0; i != vw * vh; ++i)
+	cover[i] = px[i * 3];
+    }
+    else
+    {
+      glClear(GL_COLOR_BUFFER_BIT);
+      for(int i = pass; i != end; ++i)
+      {
+	char c = GlyphFont::first + i;
+	int n = i - pass;
+	gl_draw(&c, 1, (n % cols) * cw + font.pad,
+	    vh - (n / cols + 1) * ch + font.pad + font.descent);
+      }
+      px.resize(vw * vh);
+      glReadPixels(0, 0, vw, vh, GL_RED, GL_UNSIGNED_BYTE, &px[0]);
+      for(int y = 0; y != vh; ++y)
+	memcpy(&cover[y * vw], &px[(vh - 1 - y) * vw], vw);
+    }
+
+    for(int i = pass; i != end; ++i)
+    {
+      Image& img = imgs[i];
+      int n = i - pass;
+      img.px.resize(img.w * img.h * 4);
+      for(int y = 0; y != img.h; ++y)
+      {
+	const unsigned char* src =
+	    &cover[((n / cols) * ch + y) * vw + (n % cols) * cw];
+	unsigned char* dst = &img.px[y * img.w * 4];
+	for(int x = 0; x != img.w; ++x, dst += 4)
+	{
+	  dst[0] = dst[1] = dst[2] = 255;
+	  dst[3] = src[x];
+	}
+      }
+    }
   }
+
+  if(software) fl_delete_offscreen(off);
+  else glEnable(GL_BLEND);
   return false;
 }
 
@@ -418,563 +612,555 @@ loadTex2(Sprite& sprite, const char* file, bool alpha)
  * Implementation
  */
 
-struct Level
-{
-  // physics (pixels/msec)
-  float grav;
-  float maxFallSpeed;
-  float maxPlayerSpeed;
-  float playerAccel;
-  float playerFpms;
-  float minSpeed;
-
-  // general params
-  string title;
-  int w, h;
-  float mms;
-  float mmd;
-  int baseline;
-  int topline;
-  GLfloat color[3];
-  int shakeLen;
-  int shake;
-  int fallWin[2];
-
-  // texture paths
-  string backPrefix;
-  string cntsPrefix;
-  string objsPrefix;
-  string playerPrefix;
-
-  // objects
-  Sprite back;
-  PointAcc2f player;
-  vector<Container> cnts;
-  vector<Sprite> playerAnim;
-  vector<Sprite> objs;
-};
+class Regame;
 
 
-bool
-loadLevel(Level& data, const char* file)
+// a window drawing the game's frames, through GL or on the CPU: it stays
+// up for all the levels, along with its context and textures
+class View
 {
-  string_map sm;
-  if(loadPairs(sm, file))
-    return true;
+protected:
+  Regame* game;
 
-  data.title = defaultValue(sm, "title", "title");
-  data.grav = defaultValue(sm, "grav", 0.001);
-  data.maxFallSpeed = defaultValue(sm, "maxFallSpeed", 0.2);
-  data.minSpeed = defaultValue(sm, "minSpeed", 0.2);
-  data.maxPlayerSpeed = defaultValue(sm, "maxPlayerSpeed", 0.3);
-  data.playerAccel = defaultValue(sm, "playerAccel", 0.001);
-  parseColor(data.color, defaultValue(sm, "color", "#FF0000").c_str());
-  data.w = defaultValue(sm, "w", 640);
-  data.h = defaultValue(sm, "h", 480);
-  data.mms = defaultValue(sm, "mms", 3000);
-  data.mmd = defaultValue(sm, "mmd", 2000);
-  data.player.y = defaultValue(sm, "y", 40);
-  data.baseline = defaultValue(sm, "baseline", 10);
-  data.topline = defaultValue(sm, "topline", 300);
-  data.backPrefix = defaultValue(sm, "back", "back");
-  data.cntsPrefix = defaultValue(sm, "cntsPrefix", "cnts");
-  data.objsPrefix = defaultValue(sm, "objsPrefix", "objs");
-  data.playerPrefix = defaultValue(sm, "plyrPrefix", "plyr");
-  data.playerAnim.resize(defaultValue(sm, "plyrs", 1));
-  data.playerFpms = defaultValue(sm, "plyrFpms", 80.);
-  data.shakeLen = defaultValue(sm, "shakeLen", 100);
-  data.shake = defaultValue(sm, "shake", 10);
-  data.fallWin[0] = defaultValue(sm, "fallx1", 20);
-  data.fallWin[1] = defaultValue(sm, "fallx2", 600);
-
-  int n = defaultValue(sm, "cnts", 3);
-  data.cnts.resize(n);
-  data.objs.resize(n);
-  for(int i = 0; i != n; ++i)
-  {
-    string buf("cnt");
-    buf += '0' + i; // ;)
-    data.cnts[i].accept = defaultValue(sm, buf + "t", i);
-    data.cnts[i].pos.x = defaultValue(sm, buf + "x", 0);
-    data.cnts[i].pos.y = defaultValue(sm, buf + "y", 0);
-    data.cnts[i].accWin[0].x = defaultValue(sm, buf + "ax1", 0);
-    data.cnts[i].accWin[0].y = defaultValue(sm, buf + "ay1", 0);
-    data.cnts[i].accWin[1].x = defaultValue(sm, buf + "ax2", 0);
-    data.cnts[i].accWin[1].y = defaultValue(sm, buf + "ay2", 0);
-  }
+  // a new game to init() at the next draw
+  virtual void reload() = 0;
 
-  return false;
-}
+public:
+  View(Regame& game)
+  : game(&game)
+  {}
+
+  virtual ~View()
+  {}
+
+  // switch to another level in place, resizing if needed
+  void play(Regame& game);
+
+  virtual Fl_Window* window() = 0;
+
+  // for the overlay
+  virtual const char* name() const = 0;
+
+  // draw the batch, only within the rectangles if any
+  virtual void render(const SpriteBatch& batch,
+      const vector<DamageRect>* rects) = 0;
+
+  // of the last batch
+  virtual void stats(int& drawCalls, int& vertices) const = 0;
+
+  // frames the buffer drawn into is behind, 0 if unknown
+  virtual int age() = 0;
+};
 
 
-class Regame: public Fl_Gl_Window
+class Regame
 {
   const string dataDir;
-  Level data;
-
-  // game state
-  timeval first;
-  timeval now;
-  timeval last;
-  bool started;
-  int startms;
-  int score;
-  int lives;
-  float mms;
-  float mmd;
-  int pts;
-
-  // game state
-  int oldDir;
-  vector<Particle> particles;
-  bool grabbed;
-  int grabType;
-  int key;
-  int toNext;
+  const Pack* pack;
+  Level data;			// textured: the simulation owns a copy
+
+  // the world advances in fixed steps on its own thread: draw the latest
+  // snapshot, interpolated
+  SimThread sim;
+  int overs;			// game overs already seen
+  int popupScore;
+
+  // display state
+  View* view;
+  FramePacer pacer;
+  Scene scene;
+  Random shake;			// of the containers
+
+  // rendering
+  SpriteBatch batch;
+  DamageTracker tracker;
+  int frames;
+  vector<Asset> assets;
+  vector<string> textures;	// keys held in the cache
+  int drawCalls;
+
+  // text: glyphs rasterized once, lines laid out again only when changed
+  enum
+  {
+    hudLives, hudTitle, hudStart, hudOver, hudScore, hudReset,
+    hudLines
+  };
+  enum { profLines = 10 };
+  GlyphFont hudFont;
+  GlyphFont overlayFont;
+  TextLine hud[hudLines];
+  TextLine profText[profLines];
+  void initFonts();
+  void drawCx(TextLine& line, const char* str, int y);
+
+  // profiling
+  Profiler prof;
+  bool overlay;
+  double initTime;
+  double ended;			// monotonic() end of the previous level
+  double transition;		// from then to our first frame, msecs
+  long lastSteps;
+  double lastBusy;
+  long lastMissed;
+  void drawProfile(const Snapshot& snap);
 
   // gui
   Score scoreWin;
   static void _popup(void* data);
 
   // utilities
+  void loadTextures();
+  void releaseTextures();
   void start();
   void stop();
-  void initGL();
   void update();
-  void gameover();
+  void schedule();
   static void _update(void* data);
 
-  void gl_draw_cx(const char* str, const int y);
-  void gl_sprite(const Sprite& s, const Point2f& p, const float a = 1.);
-  void gl_sprite2(const Sprite& s, const Point2f& p);
-
 public:
-  Regame(const char* dataDir, const Level* data);
+  // takes the level's data and images over, leaving it the arena
+  Regame(const char* dataDir, PreparedLevel& level, const Pack* pack = NULL);
   ~Regame();
 
+  const Level& level() const
+  { return data; }
+
+  void attach(View* view)
+  { this->view = view; }
+
+  // the previous level ended at monotonic() time t
+  void after(double t)
+  { ended = t; }
+
+  // fonts and textures, once the view is able to draw
+  void init();
+
   void reset();
-  void draw();
+
+  // lost: the view's previous contents are gone
+  void draw(bool lost);
+
+  // keys: 0 if not handled
   int handle(int ev);
 };
 
 
-Regame::Regame(const char* dataDir, const Level* data)
-: Fl_Gl_Window(data->w, data->h, data->title.c_str()),
-  dataDir(dataDir), data(*data)
+Regame::Regame(const char* dataDir, PreparedLevel& level, const Pack* pack)
+: dataDir(dataDir), pack(pack), data(std::move(level.data)),
+  sim(data, step, speed, (autopilot? new Autopilot: NULL), recordFile),
+  overs(0), popupScore(0), view(NULL), pacer(refresh), shake(rand()), frames(0),
+  drawCalls(0), overlay(false), initTime(0), ended(0), transition(0), lastSteps(0),
+  lastBusy(0), lastMissed(0)
 {
-  mode(FL_RGB | FL_DOUBLE);
-  reset();
+  if(profileFile && prof.openCsv(profileFile))
+    fprintf(stderr, "cannot write profile %s\n", profileFile);
+  assets.swap(level.assets);
+
+  // frames only grow with the particles: make room for the most there can
+  // be, so that drawing never allocates
+  size_t quads = scene.reserve(data, particleCapacity(data, step))
+      + (hudLines + profLines) * TextLine::maxLen;
+  batch.reserve(quads);
+  tracker.reserve(quads);
+
+  schedule();
+
+  // unattended: start right away
+  if(autopilot) start();
 }
 
 
 void
 Regame::stop()
 {
-  Fl::remove_timeout(_update);
-  Fl::remove_timeout(_popup);
+  Fl::remove_timeout(_update, this);
+  Fl::remove_timeout(_popup, this);
 }
 
 
 Regame::~Regame()
 {
   stop();
+  releaseTextures();
+  if(prof.steadyAllocs > 0)
+    fprintf(stderr, "%ld heap allocations after the first %d frames\n",
+	prof.steadyAllocs, static_cast<int>(Profiler::warmup));
 }
 
 
 void
 Regame::start()
 {
-  gettimeofday(&first, NULL);
-  now = last = first;
-  Fl::add_timeout(refms, _update, this);
-  startms = 0;
-  started = true;
+  sim.send(simStart);
 }
 
 
 void
 Regame::reset()
 {
-  stop();
-  redraw();
-  particles.clear();
-  started = false;
-  grabbed = false;
-  startms = 0;
-  lives = startLives;
-  pts = 0;
-  mms = data.mms;
-  mmd = data.mmd;
-  data.player.x = data.w / 2;
-  data.player.sx = 0;
-  oldDir = 0;
-  toNext = 0;
-  score = 0;
-  for(size_t i = 0; i != data.cnts.size(); ++i)
-    data.cnts[i].shakeStart = -data.shakeLen - 1;
+  Fl::remove_timeout(_popup, this);
+  sim.send(simReset);
+  scene.reset();
 }
 
 
 void
-Regame::gameover()
+Regame::drawCx(TextLine& line, const char* str, int y)
 {
-  score = startms / 1000 + pts * 100;
-
-  // some fun
-  mms = mmd = 100;
-  toNext = 0;
-
-  // give the user some time to scream
-  Fl::add_timeout(popupTime, _popup, this);
+  line.set(hudFont, str);
+  line.draw(batch, data.w / 2 - line.width() / 2, y, data.color);
 }
 
 
 void
-Regame::gl_draw_cx(const char* str, const int y)
+Regame::_update(void* data)
 {
-  gl_draw(str, w() / 2 - fl_width(str) / 2, y);
+  (reinterpret_cast<Regame*>(data))->update();
 }
 
 
 void
-Regame::gl_sprite(const Sprite& s, const Point2f& p, const float a)
+Regame::_popup(void* data)
 {
-  glColor4f(1, 1, 1, a);
-  gl_sprite2(s, p);
+  Regame* rg = reinterpret_cast<Regame*>(data);
+  rg->scoreWin.show(rg->popupScore, rg->data.title.c_str());
 }
 
 
+// FLTK timers are only as good as the event loop: fire a bit early and let
+// the pacer sleep off the rest
 void
-Regame::gl_sprite2(const Sprite& s, const Point2f& p)
+Regame::schedule()
 {
-  glEnable(target);
-  glBindTexture(target, s.tex);
-  glBegin(GL_QUADS);
-  glTexCoord2f(0   , s.rh); glVertex2f(p.x      , p.y      );
-  glTexCoord2f(s.rw, s.rh); glVertex2f(p.x + s.w, p.y      );
-  glTexCoord2f(s.rw, 0   ); glVertex2f(p.x + s.w, p.y + s.h);
-  glTexCoord2f(0   , 0   ); glVertex2f(p.x      , p.y + s.h);
-  glEnd();
-  glDisable(target);
+  double left = pacer.remaining() - paceSlack;
+  Fl::add_timeout((left > 0? left: 0), _update, this);
 }
 
 
 void
-Regame::_update(void* data)
+Regame::update()
 {
-  Fl::repeat_timeout(refms, _update, data);
-  (reinterpret_cast<Regame*>(data))->update();
-}
+  pacer.wait();
 
+  // draw right at the deadline when there's something new, or to keep
+  // interpolating
+  bool fresh = sim.pending();
+  const Snapshot& snap = sim.read();
+  if(view && (fresh || snap.started))
+  {
+    // a full redraw() would also tell the damage tracker the contents got
+    // lost
+    if(damageMode) view->window()->damage(FL_DAMAGE_USER1);
+    else view->window()->redraw();
+    Fl::flush();
+  }
 
-void
-Regame::_popup(void* data)
-{
-  Regame* rg = reinterpret_cast<Regame*>(data);
-  rg->scoreWin.show(rg->score, rg->data.title.c_str());
+  // give the user some time to scream
+  if(snap.overs != overs)
+  {
+    overs = snap.overs;
+    popupScore = snap.score;
+    if(!autopilot) Fl::add_timeout(popupTime, _popup, this);
+  }
+
+  schedule();
 }
 
 
 void
-Regame::update()
+Regame::initFonts()
 {
-  gettimeofday(&now, NULL);
-  int delta = tvdiff(now, last);
-  if(!delta) return;
-  startms = tvdiff(now, first);
-  last = now;
-  redraw();
-
-  int k = kpLR(key);
-  if(k == FL_Left)
+  double start = monotonic();
+  vector<Image> hudImgs, overlayImgs;
+  fontMetrics(hudFont, hudImgs, font, fontSize);
+  fontMetrics(overlayFont, overlayImgs, profFont, profFontSize);
+
+  // both fonts in one atlas
+  vector<Sprite*> sprites;
+  vector<const Image*> imgs;
+  vector<string> keys;
+  char buf[64];
+  for(size_t i = 0; i != hudImgs.size(); ++i)
   {
-    data.player.sx -= data.playerAccel * delta;
-    if(data.player.sx < -data.maxPlayerSpeed)
-      data.player.sx = -data.maxPlayerSpeed;
+    sprites.push_back(&hudFont.glyphs[i]);
+    imgs.push_back(&hudImgs[i]);
+    snprintf(buf, sizeof(buf), "font:%d:%d:%d#rgba", font, fontSize,
+	static_cast<int>(i));
+    keys.push_back(buf);
   }
-  else if(k == FL_Right)
+  for(size_t i = 0; i != overlayImgs.size(); ++i)
   {
-    data.player.sx += data.playerAccel * delta;
-    if(data.player.sx > data.maxPlayerSpeed)
-      data.player.sx = data.maxPlayerSpeed;
+    sprites.push_back(&overlayFont.glyphs[i]);
+    imgs.push_back(&overlayImgs[i]);
+    snprintf(buf, sizeof(buf), "font:%d:%d:%d#rgba", profFont, profFontSize,
+	static_cast<int>(i));
+    keys.push_back(buf);
   }
-  else if(data.player.sx)
+
+  // drawn only if a previous level didn't
+  TextureCache& cache = textureCache();
+  bool drawn = true;
+  for(size_t i = 0; drawn && i != keys.size(); ++i)
+    drawn = cache.cached(keys[i]);
+  if(!drawn
+  && (rasterFont(hudFont, hudImgs, font, fontSize, data.w, data.h)
+      || rasterFont(overlayFont, overlayImgs, profFont, profFontSize,
+	  data.w, data.h)))
   {
-    float d = copysign(1, data.player.sx) * data.playerAccel * delta;
-    if(fabs(d) > fabs(data.player.sx))
-      data.player.sx = 0;
-    else
-      data.player.sx -= d;
+    fprintf(stderr, "cannot rasterize the fonts\n");
+    hudFont.glyphs.clear();
+    overlayFont.glyphs.clear();
+    return;
   }
+  loadCached(sprites, imgs, keys, textures);
 
-  data.player.x += delta * data.player.sx;
-  if(data.player.x < 0) { data.player.x = 0; data.player.sx = 0; }
-  if(data.player.x > data.w) { data.player.x = data.w; data.player.sx = 0; }
+  // the glyphs moved: lay everything out again
+  for(int i = 0; i != hudLines; ++i)
+    hud[i] = TextLine();
+  for(int i = 0; i != profLines; ++i)
+    profText[i] = TextLine();
 
-  // new particles
-  int immd = static_cast<int>(mmd);
-  if(immd > 0 && (toNext -= delta) < 0)
+  if(timing)
   {
-    toNext += mms + rand() % immd;
-
-    Particle buf;
-    buf.type = rand() % data.cnts.size();
-    buf.x = data.fallWin[0] + rand() % (data.fallWin[1] - data.fallWin[0]);
-    buf.y = data.h + data.objs[buf.type].h;
-    buf.sx = buf.sy = 0;
-    buf.grabbed = false;
-    buf.maxSpeed = (rand() + RAND_MAX / 5.) / RAND_MAX * data.maxFallSpeed;
-    buf.rand = rand();
-    particles.push_back(buf);
+    fprintf(stderr, "fonts: %d glyphs%s, %.2f ms\n",
+	static_cast<int>(sprites.size()), (drawn? " (cached)": ""),
+	(monotonic() - start) * 1e3);
   }
+}
+
+
+void
+Regame::releaseTextures()
+{
+  TextureCache& cache = textureCache();
+  for(size_t i = 0; i != textures.size(); ++i)
+    cache.release(textures[i]);
+  textures.clear();
+}
 
-  // recalculate positions
-  for(vector<Particle>::iterator it = particles.begin();
-      it != particles.end();)
+
+void
+Regame::loadTextures()
+{
+  // prebuilt textures, if any
+  if(pack && !loadPacked(data, *pack, textures))
+    return;
+
+  // decoded beforehand, unless the pack fell short: in parallel then
+  double start = monotonic();
+  if(!assets.size())
+    decodeLevel(assets, data, dataDir, decoder());
+  double decoded = monotonic();
+
+  // loading errors of textures is ignored...
+  vector<const Image*> imgs;
+  vector<string> keys;
+  for(size_t i = 0; i != assets.size(); ++i)
   {
-    if(!it->grabbed || it->y > data.topline)
+    if(assets[i].failed)
     {
-      it->grabbed = false;
-      it->sy -= data.grav * delta;
-      if(it->sy < -it->maxSpeed)
-	it->sy = -it->maxSpeed;
+      fprintf(stderr, "cannot load texture %s\n", assets[i].file.c_str());
+      assets[i].img.w = assets[i].img.h = 0;
     }
-    it->y += delta * it->sy;
-
-    if(!it->grabbed && it->y < data.player.y + data.playerAnim[0].h)
+    if(timing)
     {
-      if(!grabbed && it->y > data.player.y && labs(it->x - data.player.x) < data.playerAnim[0].w / 2)
-      {
-	grabbed = true;
-	grabType = it->type;
-	particles.erase(it);
-	continue;
-      }
-      else if(it->y < data.baseline)
-      {
-	if(it->maxSpeed > data.minSpeed)
-	{
-	  it->y = data.baseline;
-	  it->sy = it->maxSpeed;
-	  it->maxSpeed /= 2;
-	}
-	else if(it->y < -data.objs[it->type].h)
-	{
-	  if(!--lives) gameover();
-	  particles.erase(it);
-	  continue;
-	}
-      }
+      fprintf(stderr, "%s: decode %.2f ms\n",
+	  assets[i].file.c_str(), assets[i].decodeTime * 1e3);
     }
+    keys.push_back(textureKey(assets[i].file, assets[i].alpha));
+    if(i) imgs.push_back(&assets[i].img);
+  }
 
-    if(it->grabbed)
+  // the drawing thread only uploads, what's not there already
+  TextureCache& cache = textureCache();
+  if(!assets[0].failed)
+  {
+    textures.push_back(keys[0]);
+    if(cache.acquire(keys[0], data.back))
     {
-      vector<Container>::iterator ct;
-      for(ct = data.cnts.begin(); ct != data.cnts.end(); ++ct)
-      {
-	if(it->type == ct->accept
-	&& it->x > ct->pos.x + ct->accWin[0].x
-	&& it->x < ct->pos.x + ct->accWin[1].x
-	&& it->y > ct->pos.y + ct->accWin[0].y)
-	  break;
-      }
-      if(ct != data.cnts.end())
+      double upStart = monotonic();
+      const Image& back = assets[0].img;
+      uploadTex(data.back, back);
+      cache.add(data.back.tex, texBytes(back.w, back.h, back.chans));
+      cache.insert(keys[0], data.back);
+      if(timing)
       {
-	++pts;
-	particles.erase(it);
-	ct->shakeStart = startms;
-	continue;
+	fprintf(stderr, "%s: upload %.2f ms\n",
+	    assets[0].file.c_str(), (monotonic() - upStart) * 1e3);
       }
     }
-
-    ++it;
   }
+  vector<Sprite*> sprites;
+  vector<string> files;
+  levelSprites(data, sprites, files);
+  keys.erase(keys.begin());
+  loadCached(sprites, imgs, keys, textures);
 
-  mms -= delta / 100.;
-  mmd -= delta / 1000.;
+  if(timing)
+  {
+    fprintf(stderr, "textures: decode %.2f ms (wall), total %.2f ms\n",
+	(decoded - start) * 1e3, (monotonic() - start) * 1e3);
+  }
 }
 
 
 void
-Regame::initGL()
+Regame::init()
 {
-  string buf;
-
-  // initial settings
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-  // detect GL_TEXTURE_RECTANGLE_ARB availability
-  while(glGetError());
-  glEnable(GL_TEXTURE_RECTANGLE_ARB);
-  if(glGetError()) target = GL_TEXTURE_2D;
-  else glDisable(GL_TEXTURE_RECTANGLE_ARB);
+  ScopedTimer t(initTime);
 
-  // background
-  loadTex2(data.back, (dataDir + "/" + data.backPrefix + ".png").c_str(), false);
+  // again if the context was lost
+  releaseTextures();
+  initFonts();
+  loadTextures();
 
-  // player
-  for(size_t i = 0; i != data.playerAnim.size(); ++i)
+  // what the previous level had and we don't
+  TextureCache& cache = textureCache();
+  cache.evict();
+  if(timing)
   {
-    buf = dataDir;
-    buf += "/";
-    buf += data.playerPrefix;
-    buf += '0' + i;
-    buf += ".png";
-    loadTex2(data.playerAnim[i], buf.c_str(), true);
+    fprintf(stderr, "texture cache: %d texture(s), %.2f MB, %ld hits, "
+	"%ld misses\n", cache.size(), cache.bytes / 1048576., cache.hits,
+	cache.misses);
   }
+}
 
-  // containers
-  for(size_t i = 0; i != data.cnts.size(); ++i)
-  {
-    buf = dataDir;
-    buf += "/";
-    buf += data.cntsPrefix;
-    buf += '0' + i;
-    buf += ".png";
-    loadTex2(data.cnts[i].s, buf.c_str(), true);
-  }
 
-  // objects
-  for(size_t i = 0; i != data.objs.size(); ++i)
-  {
-    buf = dataDir;
-    buf += "/";
-    buf += data.objsPrefix;
-    buf += '0' + i;
-    buf += ".png";
-    loadTex2(data.objs[i], buf.c_str(), true);
-  }
-}
 
 
 void
-Regame::draw()
+Regame::draw(bool lost)
 {
-  if(!valid())
+  prof.frame();
+  ScopedTimer t(prof.cur.draw);
+  if(lost) tracker.reset(data.w, data.h);
+
+  const Snapshot& snap = sim.read();
+  prof.cur.update = snap.busy - lastBusy;
+  prof.cur.steps = snap.steps - lastSteps;
+  prof.cur.late = snap.late;
+  prof.cur.missed = pacer.skipped() - lastMissed;
+  lastMissed = pacer.skipped();
+  lastBusy = snap.busy;
+  lastSteps = snap.steps;
+  batch.clear();
+
+  // blend the last two steps by the time since the last one
+  float alpha = 0;
+  if(snap.started)
   {
-    if(!context_valid())
-    {
-#ifdef EXTENDED_FLTK
-      vsync(1);
-#endif
-      initGL();
-    }
-
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glMatrixMode(GL_MODELVIEW);
-    ortho();
+    alpha = (monotonic() - snap.time) * 1000. * speed / step;
+    if(alpha > 1) alpha = 1;
   }
+  scene.build(batch, data, snap, alpha, step, shake);
 
-  // background
-  gl_sprite(data.back, Point2f(0, 0));
-
-  gl_font(font, fontSize);
+  // scores, in the same batch
   char buf[64];
 
-  // scores
-  if(started)
+  if(snap.started)
   {
-    glColor3fv(data.color);
-    int y = data.h;
-#if 0
-    sprintf(buf, "ms: %d", startms);
-    gl_draw(buf, fontSpc, y -= fontSize);
-    sprintf(buf, "mms: %.f", mms);
-    gl_draw(buf, fontSpc, y -= fontSize);
-    sprintf(buf, "mmd: %.f", mmd);
-    gl_draw(buf, fontSpc, y -= fontSize);
-    sprintf(buf, "pts: %d", pts);
-    gl_draw(buf, fontSpc, y -= fontSize);
-#endif
-    sprintf(buf, "LIVES: %d", lives);
-    gl_draw(buf, fontSpc, y -= fontSize);
+    sprintf(buf, "LIVES: %d", snap.lives);
+    hud[hudLives].set(hudFont, buf);
+    hud[hudLives].draw(batch, fontSpc, data.h - fontSize, data.color);
   }
 
-  // containers
-  for(size_t i = 0; i != data.cnts.size(); ++i)
+  // other text
+  if(snap.lives <= 0)
   {
-    if(data.cnts[i].shakeStart < startms
-    && data.cnts[i].shakeStart + data.shakeLen < startms)
-      gl_sprite(data.cnts[i].s, data.cnts[i].pos);
-    else
-      gl_sprite(data.cnts[i].s, Point2f(
-	      data.cnts[i].pos.x + rand() % data.shake - data.shake / 2,
-	      data.cnts[i].pos.y + rand() % data.shake - data.shake / 2));
+    int y = data.h / 1.1;
+    drawCx(hud[hudOver], "GAME OVER", y -= fontSize);
+    sprintf(buf, "YOUR SCORE: %d", snap.score);
+    drawCx(hud[hudScore], buf, y -= fontSize);
+    drawCx(hud[hudReset], "- ESC to reset -", y -= fontSize);
+  }
+  else if(!snap.started)
+  {
+    int y = data.h / 1.5;
+    drawCx(hud[hudTitle], data.title.c_str(), y -= fontSize);
+    drawCx(hud[hudStart], "- space to start -", y -= fontSize);
   }
 
-  // player
-  int playerFrame = (!data.player.sx? 0:
-      static_cast<int>(startms / data.playerFpms)
-		   % data.playerAnim.size());
-
-  if(!oldDir || data.player.sx)
-    oldDir = (data.player.sx >= 0? 1: 2);
-
-  glPushMatrix();
-  glTranslated(data.player.x, data.player.y, 0);
-  if(oldDir == 2) glScaled(-1, 1, 1);
-
-  glPushMatrix();
-  glScaled(1, -0.3, 1);
-  glColor4f(0, 0, 0, 0.3);
-  gl_sprite2(data.playerAnim[playerFrame],
-      Point2f(-data.playerAnim[playerFrame].w / 2, 0));
-  glPopMatrix();
-
-  gl_sprite(data.playerAnim[playerFrame],
-      Point2f(-data.playerAnim[playerFrame].w / 2, 0));
-  glPopMatrix();
+  if(overlay) drawProfile(snap);
 
-  // grabbed particle
-  if(grabbed)
+  if(damageMode)
   {
-    glPushMatrix();
-    glTranslated(data.player.x - data.playerAnim[playerFrame].w / 2,
-	data.player.y + data.playerAnim[playerFrame].h - data.objs[grabType].h / 2, 0);
-    glScaled(0.5, 0.5, 0);
-    gl_sprite(data.objs[grabType], Point2f(0, 0));
-    glPopMatrix();
+    tracker.update(batch, view->age());
+    view->render(batch, (tracker.whole? NULL: &tracker.rects));
+    prof.cur.touched = tracker.touched;
   }
-
-  // particles
-  for(vector<Particle>::const_iterator it = particles.begin();
-      it != particles.end(); ++it)
+  else
   {
-    float a = (it->grabbed || (it->y < data.baseline)? 0.5: 1);
-    double r = it->rand + startms / (100. +
-	(static_cast<double>(it->rand) / RAND_MAX * 160. - 90.));
-    r = fmod(r, 360.);
-    if(it->rand % 2) r = -r;
-
-    glPushMatrix();
-    glTranslated(it->x, it->y, 0);
-    glRotated(r, 0, 0, 1);
-
-    gl_sprite(data.objs[it->type], Point2f(
-	    -data.objs[it->type].w / 2,
-	    -data.objs[it->type].h / 2), a);
-
-    glPopMatrix();
+    view->render(batch, NULL);
+    prof.cur.touched = 1;
   }
 
-  // other text
-  if(lives <= 0)
+  int vertices;
+  view->stats(drawCalls, vertices);
+  prof.cur.particles = snap.x.size();
+  prof.cur.drawCalls = drawCalls;
+  if(stats && !(++frames % 60))
+    fprintf(stderr, "draw calls: %d, vertices: %d, missed frames: %ld, "
+	"redrawn: %.1f%%\n", drawCalls, vertices, pacer.skipped(),
+	prof.cur.touched * 100);
+
+  if(ended)
   {
-    int y = data.h / 1.1;
-    glColor3fv(data.color);
-    gl_draw_cx("GAME OVER", y -= fontSize);
-    sprintf(buf, "YOUR SCORE: %d", score);
-    gl_draw_cx(buf, y -= fontSize);
-    gl_draw_cx("- ESC to reset -", y -= fontSize);
+    transition = (monotonic() - ended) * 1e3;
+    ended = 0;
+    if(timing) fprintf(stderr, "level transition: %.2f ms\n", transition);
   }
-  else if(!started)
+}
+
+
+void
+Regame::drawProfile(const Snapshot& snap)
+{
+  const int lines = profLines;
+  char buf[lines][128];
+  snprintf(buf[0], sizeof(buf[0]),
+      "frame p50 %5.2f p95 %5.2f p99 %5.2f max %5.2f ms",
+      prof.percentile(&FrameStats::frame, 50),
+      prof.percentile(&FrameStats::frame, 95),
+      prof.percentile(&FrameStats::frame, 99),
+      prof.maximum(&FrameStats::frame));
+  snprintf(buf[1], sizeof(buf[1]),
+      "update %5.2f draw %5.2f ms, p95 %5.2f %5.2f ms",
+      prof.average(&FrameStats::update), prof.average(&FrameStats::draw),
+      prof.percentile(&FrameStats::update, 95),
+      prof.percentile(&FrameStats::draw, 95));
+  snprintf(buf[2], sizeof(buf[2]), "sim late p50 %5.2f p95 %5.2f max %5.2f ms",
+      prof.percentile(&FrameStats::late, 50),
+      prof.percentile(&FrameStats::late, 95),
+      prof.maximum(&FrameStats::late));
+  snprintf(buf[3], sizeof(buf[3]), "particles %d, last draw calls %d",
+      static_cast<int>(snap.x.size()), drawCalls);
+  snprintf(buf[4], sizeof(buf[4]), "ms %d, mms %.f, mmd %.f, pts %d",
+      snap.startms, snap.mms, snap.mmd, snap.pts);
+  snprintf(buf[5], sizeof(buf[5]),
+      "init %.2f ms, transition %.2f ms, step %d ms, %d frames",
+      initTime, transition, step, static_cast<int>(prof.size()));
+  snprintf(buf[6], sizeof(buf[6]), "pacer %.f Hz%s, missed %ld frames",
+      pacer.rate(), (swapSync? " + swap sync": ""), pacer.skipped());
+  snprintf(buf[7], sizeof(buf[7]), "%s, %s redrawn p50 %5.1f%% max %5.1f%%",
+      view->name(), (damageMode? "damage,": "full,"),
+      prof.percentile(&FrameStats::touched, 50) * 100,
+      prof.maximum(&FrameStats::touched) * 100);
+  if(prof.steadyAllocs < 0)
+    snprintf(buf[8], sizeof(buf[8]), "heap allocations not counted");
+  else
+    snprintf(buf[8], sizeof(buf[8]), "heap allocs %ld last frame, %ld after warmup",
+	prof.previous().allocs, prof.steadyAllocs);
+  const TextureCache& cache = textureCache();
+  snprintf(buf[9], sizeof(buf[9]), "textures %d, %.2f MB, hits %ld, misses %ld",
+      cache.size(), cache.bytes / 1048576., cache.hits, cache.misses);
+
+  int y = data.h;
+  for(int i = 0; i != lines; ++i)
   {
-    int y = data.h / 1.5;
-    glColor3fv(data.color);
-    gl_draw_cx(data.title.c_str(), y -= fontSize);
-    gl_draw_cx("- space to start -", y -= fontSize);
+    TextLine& line = profText[i];
+    line.set(overlayFont, buf[i]);
+    line.draw(batch, data.w - line.width() - fontSpc, y -= profFontSize,
+	data.color);
   }
 }
 
@@ -983,44 +1169,37 @@ int
 Regame::handle(int ev)
 {
   if(ev != FL_KEYDOWN && ev != FL_KEYUP)
-    return Fl_Gl_Window::handle(ev);
+    return 0;
 
+  // the simulation applies everything on its next step
+  bool started = sim.read().started;
   if(ev == FL_KEYUP)
   {
-    if(key == Fl::event_key())
-      key = 0;
+    if(kpLR(Fl::event_key()))
+      sim.send(simKeyUp, Fl::event_key());
   }
   else
   {
     switch(Fl::event_key())
     {
     case ' ':
-      if(!started)
-	start();
-      else if(grabbed)
-      {
-	grabbed = false;
-
-	// reinject the particle
-	Particle buf(data.player.x,
-	    data.player.y + data.playerAnim[0].h / 2,
-	    0, data.maxFallSpeed);
-	buf.type = grabType;
-	buf.grabbed = true;
-	buf.maxSpeed = data.maxFallSpeed / 2;
-	buf.rand = rand();
-	particles.push_back(buf);
-      }
+      if(!started) start();
+      else sim.send(simRelease);
+      break;
+
+    case 'p':
+      overlay = !overlay;
+      view->window()->redraw();
       break;
 
     case FL_Escape:
       if(started) reset();
-      else return Fl_Gl_Window::handle(ev);
+      else return 0;
       break;
 
     default:
       if(kpLR(Fl::event_key()))
-	key = Fl::event_key();
+	sim.send(simKeyDown, Fl::event_key(), kpLR(Fl::event_key()));
       break;
     }
   }
@@ -1029,50 +1208,473 @@ Regame::handle(int ev)
 }
 
 
+
+/*
+ * Views
+ */
+
+class GLView: public Fl_Gl_Window, public View
+{
+  GLRenderer renderer;
+  bool loaded;
+  bool ageQuery;
+
+  void initGL();
+  void reload()
+  { loaded = false; }
+
+public:
+  GLView(Regame& game);
+  ~GLView();
+
+  Fl_Window* window()
+  { return this; }
+
+  const char* name() const
+  { return "gl"; }
+
+  void render(const SpriteBatch& batch, const vector<DamageRect>* rects);
+  void stats(int& drawCalls, int& vertices) const;
+  void draw();
+  int handle(int ev);
+
+  // swapped buffers have no contents guaranteed, unless asked for
+  int age()
+  { return (ageQuery? bufferAge(this): 0); }
+};
+
+
+GLView::GLView(Regame& game)
+: Fl_Gl_Window(game.level().w, game.level().h, game.level().title.c_str()),
+  View(game), loaded(false), ageQuery(false)
+{
+  mode(FL_RGB | FL_DOUBLE);
+  game.attach(this);
+}
+
+
+// the textures go with the context
+GLView::~GLView()
+{
+  if(context())
+  {
+    make_current();
+    textureCache().clear();
+  }
+}
+
+
+void
+GLView::initGL()
+{
+  // initial settings
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  // detect GL_TEXTURE_RECTANGLE_ARB availability
+  while(glGetError());
+  glEnable(GL_TEXTURE_RECTANGLE_ARB);
+  if(glGetError()) target = GL_TEXTURE_2D;
+  else glDisable(GL_TEXTURE_RECTANGLE_ARB);
+  renderer.init(target);
+  ageQuery = bufferAgeQuery();
+
+  // a new context: nothing cached is there
+  textureCache().clear();
+  loaded = false;
+}
+
+
+void
+GLView::render(const SpriteBatch& batch, const vector<DamageRect>* rects)
+{
+  if(rects) renderer.draw(batch, *rects);
+  else renderer.draw(batch);
+}
+
+
+void
+GLView::stats(int& drawCalls, int& vertices) const
+{
+  drawCalls = renderer.drawCalls;
+  vertices = renderer.vertices;
+}
+
+
+void
+GLView::draw()
+{
+  bool lost = (!valid() || !loaded || (damage() & ~FL_DAMAGE_USER1));
+  if(!valid())
+  {
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    ortho();
+
+    if(!context_valid())
+    {
+#ifdef EXTENDED_FLTK
+      vsync(swapSync);
+#else
+      if(swapSync && swapInterval(1))
+	fprintf(stderr, "swap interval control not available\n");
+#endif
+      initGL();
+    }
+  }
+  if(!loaded)
+  {
+    loaded = true;
+    game->init();
+  }
+
+  game->draw(lost);
+}
+
+
+int
+GLView::handle(int ev)
+{
+  int ret = game->handle(ev);
+  return (ret? ret: Fl_Gl_Window::handle(ev));
+}
+
+
+// frames drawn on the CPU and copied into a plain double-buffered window,
+// which keeps them between redraws: only what was drawn again is copied
+class SoftView: public Fl_Double_Window, public View
+{
+  bool ready;
+  string label;
+
+  void present(const DamageRect& r);
+  void reload()
+  { ready = false; }
+
+public:
+  SoftView(Regame& game);
+
+  Fl_Window* window()
+  { return this; }
+
+  const char* name() const
+  { return label.c_str(); }
+
+  void render(const SpriteBatch& batch, const vector<DamageRect>* rects);
+  void stats(int& drawCalls, int& vertices) const;
+  void draw();
+  int handle(int ev);
+
+  // the framebuffer keeps the last frame exactly
+  int age()
+  { return 1; }
+};
+
+
+SoftView::SoftView(Regame& game)
+: Fl_Double_Window(game.level().w, game.level().h,
+      game.level().title.c_str()),
+  View(game), ready(false), label(string("soft ") + softKernel())
+{
+  game.attach(this);
+}
+
+
+void
+SoftView::present(const DamageRect& r)
+{
+  // bottom row first: start from the top one, going backwards
+  SoftRenderer& sr = softRenderer();
+  const uint32_t* top = &sr.fb[(r.y + r.h - 1) * sr.w + r.x];
+  fl_draw_image(reinterpret_cast<const unsigned char*>(top), r.x,
+      sr.h - r.y - r.h, r.w, r.h, 4, -sr.w * 4);
+}
+
+
+void
+SoftView::render(const SpriteBatch& batch, const vector<DamageRect>* rects)
+{
+  SoftRenderer& sr = softRenderer();
+  if(rects)
+  {
+    sr.draw(batch, *rects);
+    for(size_t i = 0; i != rects->size(); ++i)
+      present((*rects)[i]);
+  }
+  else
+  {
+    DamageRect all = {0, 0, sr.w, sr.h};
+    sr.draw(batch);
+    present(all);
+  }
+}
+
+
+void
+SoftView::stats(int& drawCalls, int& vertices) const
+{
+  const SoftRenderer& sr = softRenderer();
+  drawCalls = sr.drawCalls;
+  vertices = sr.vertices;
+}
+
+
+void
+SoftView::draw()
+{
+  // the fonts need a window to draw into
+  bool lost = (damage() & ~FL_DAMAGE_USER1);
+  if(!ready)
+  {
+    ready = lost = true;
+    softRenderer().resize(w(), h());
+    game->init();
+  }
+
+  game->draw(lost);
+}
+
+
+int
+SoftView::handle(int ev)
+{
+  int ret = game->handle(ev);
+  return (ret? ret: Fl_Double_Window::handle(ev));
+}
+
+
+void
+View::play(Regame& game)
+{
+  this->game = &game;
+  game.attach(this);
+  reload();
+
+  const Level& data = game.level();
+  Fl_Window* win = window();
+  win->label(data.title.c_str());
+  if(win->w() != data.w || win->h() != data.h)
+    win->size(data.w, data.h);
+  win->redraw();
+}
+
+
+// closing the window ends the level, not the game
+void
+closeLevel(Fl_Widget*, void* closed)
+{
+  *static_cast<bool*>(closed) = true;
+}
+
+
+// until its window is closed, along with any dialog it left open
+bool
+playing(Fl_Window* win, bool closed)
+{
+  for(Fl_Window* w = Fl::first_window(); w; w = Fl::next_window(w))
+    if(w != win) return true;
+  return (!closed && win->shown());
+}
+
+
+// headless replay of an input log, at full speed
+int
+replayLog(const char* prg, const char* file, const char* dataDir,
+    const Pack* pack)
+{
+  InputLog log;
+  if(log.load(file))
+  {
+    fprintf(stderr, "%s: cannot load input log %s\n", prg, file);
+    return EXIT_FAILURE;
+  }
+
+  Level data;
+  if(loadLevelData(data, dataDir, pack, log.level)
+  || (pack? loadSpriteSizes(data, *pack): loadSpriteSizes(data, dataDir)))
+  {
+    fprintf(stderr, "%s: cannot load level %s\n", prg, log.level.c_str());
+    return EXIT_FAILURE;
+  }
+
+  World world(data);
+  ReplayStats st;
+  bool mismatch = replay(world, log, st);
+
+  printf("replay: %s, seed %u, step %u ms, %lu events\n", log.level.c_str(),
+      log.seed, log.step, static_cast<unsigned long>(log.events.size()));
+  printf("steps: %ld, elapsed: %.3f ms, worst step: %.4f ms\n",
+      st.steps, st.elapsed * 1e3, st.worstStep * 1e3);
+  printf("score: %d (%d), lives: %d (%d): %s\n", world.score, log.score,
+      world.lives, log.lives, (mismatch? "MISMATCH": "ok"));
+
+  return (mismatch? EXIT_FAILURE: EXIT_SUCCESS);
+}
+
+
 int
 main(int argc, char* argv[])
 {
-  // search for game data
+  // options
+  static const option longOpts[] =
+  {
+    {"record", required_argument, NULL, 'r'},
+    {"replay", required_argument, NULL, 'R'},
+    {"profile", required_argument, NULL, 'P'},
+    {"autopilot", no_argument, NULL, 'a'},
+    {"refresh", required_argument, NULL, 'F'},
+    {"vsync", no_argument, NULL, 'V'},
+    {"damage", no_argument, NULL, 'D'},
+    {"software", no_argument, NULL, 'S'},
+    {NULL, 0, NULL, 0}
+  };
+
+  const char* replayFile = NULL;
+  int c;
+  while((c = getopt_long(argc, argv, "stf:x:ar:R:P:F:VDS", longOpts, NULL)) != -1)
+  {
+    switch(c)
+    {
+    case 's': stats = true; break;
+    case 't': timing = true; break;
+    case 'f': step = atoi(optarg); break;
+    case 'x': speed = atof(optarg); break;
+    case 'a': autopilot = true; break;
+    case 'r': recordFile = optarg; break;
+    case 'R': replayFile = optarg; break;
+    case 'P': profileFile = optarg; break;
+    case 'F': refresh = atof(optarg); break;
+    case 'V': swapSync = true; break;
+    case 'D': damageMode = true; break;
+    case 'S': software = true; break;
+    default:
+      c = 0;
+    }
+    if(!c || step < 1 || step > SimThread::maxCatchup || speed <= 0
+    || refresh <= 0)
+    {
+      fprintf(stderr, "usage: %s [-s] [-t] [-f step] [-x speed] [--autopilot]\n"
+	  "\t[--record file] [--replay file] [--profile file] [-F hz] [-V] [-D] [-S]\n"
+	  "  -s\t\tprint rendering statistics\n"
+	  "  -t\t\tprint asset loading times\n"
+	  "  -f step\tsimulation step in msecs (4)\n"
+	  "  -x speed\tsimulated time per real time (1)\n"
+	  "  -a, --autopilot\n\t\tplay unattended\n"
+	  "  -r, --record file\n\t\tlog the input of each game to file\n"
+	  "  -R, --replay file\n\t\treplay a log headlessly and verify the score\n"
+	  "  -P, --profile file\n\t\tdump per-frame timings as CSV (p toggles the overlay)\n"
+	  "  -F, --refresh hz\n\t\tframes per second (60)\n"
+	  "  -V, --vsync\tsync buffer swaps to the display too\n"
+	  "  -D, --damage\tredraw only the regions which changed\n"
+	  "  -S, --software\n\t\tdraw on the CPU instead of through OpenGL\n",
+	  argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // search for game data, preprocessed or not
   const char* dataDir = ".";
   string buf = string(dataDir) + "/" + gameData;
-  if(access(buf.c_str(), R_OK))
+  string pak = string(dataDir) + "/" + gamePack;
+  if(access(buf.c_str(), R_OK) && access(pak.c_str(), R_OK))
+  {
+    dataDir = getResDir();
+    buf = string(dataDir) + "/" + gameData;
+    pak = string(dataDir) + "/" + gamePack;
+  }
+
+  Pack pack;
+  bool packed = !access(pak.c_str(), R_OK);
+  if(packed && pack.open(pak.c_str()))
   {
-    buf = dataDir = getResDir();
-    buf += "/";
-    buf += gameData;
+    fprintf(stderr, "%s: ignoring invalid pack %s\n", argv[0], pak.c_str());
+    packed = false;
   }
 
   string_map sm;
-  if(loadPairs(sm, buf.c_str()))
+  if(packed? pack.pairs(sm, gameData): loadPairs(sm, buf.c_str()))
   {
-    fprintf(stderr, "%s: cannot load game data from %s\n", argv[0], buf.c_str());
+    fprintf(stderr, "%s: cannot load game data from %s\n", argv[0],
+	(packed? pak: buf).c_str());
     return EXIT_FAILURE;
   }
 
+  if(replayFile)
+    return replayLog(argv[0], replayFile, dataDir, (packed? &pack: NULL));
+
   srand(time(NULL));
 
-  // run through levels; but no concept of EndGame yet...
+  // run through levels in the same window; but no concept of EndGame yet...
+  Preloader preloader;
+  PreparedLevel* current = NULL;
+  Regame* game = NULL;
+  View* view = NULL;
+  double ended = 0;
+  bool closed = false;
   for(int i = 0;; ++i)
   {
-    buf = "level";
-    buf += '0' + i;
-    string_map::const_iterator st = sm.find(buf);
+    string_map::const_iterator st = sm.find(numbered("level", i));
     if(st == sm.end()) break;
-    buf = string(dataDir) + "/" + st->second;
 
-    Level data;
-    if(loadLevel(data, buf.c_str()))
+    // the simulation needs the sprite sizes before the textures exist: the
+    // first level is prepared right away, the others while the previous
+    // one is played. What a level allocates for itself goes all at once
+    // when it ends
+    PreparedLevel* level;
+    if(!i)
     {
-      fprintf(stderr, "%s: cannot load level %d from %s\n", argv[0], i, buf.c_str());
+      level = new PreparedLevel;
+      if(prepareLevel(*level, dataDir, (packed? &pack: NULL), st->second,
+	      decoder()))
+      {
+	delete level;
+	level = NULL;
+      }
+    }
+    else
+      level = preloader.take();
+    if(!level)
+    {
+      fprintf(stderr, "%s: cannot load level %d from %s\n", argv[0], i,
+	  (packed? pak: string(dataDir) + "/" + st->second).c_str());
       return EXIT_FAILURE;
     }
+    if(timing)
+    {
+      fprintf(stderr, "%s: prepared in %.2f ms%s\n", st->second.c_str(),
+	  level->time, (i? " (in the background)": ""));
+    }
 
-    Regame* game = new Regame(dataDir, &data);
-    game->show();
-    Fl::run();
-    delete game;
+    string_map::const_iterator next = sm.find(numbered("level", i + 1));
+    if(next != sm.end())
+      preloader.start(dataDir, (packed? &pack: NULL), next->second);
+
+    Regame* prev = game;
+    game = new Regame(dataDir, *level, (packed? &pack: NULL));
+    game->after(ended);
+    if(view)
+      view->play(*game);
+    else
+    {
+      view = (software? static_cast<View*>(new SoftView(*game)):
+	  new GLView(*game));
+      view->window()->callback(closeLevel, &closed);
+      view->window()->show();
+    }
+    delete prev;
+    delete current;
+    current = level;
+
+    closed = false;
+    while(playing(view->window(), closed))
+      Fl::wait();
+    ended = monotonic();
   }
 
+  delete view;
+  delete game;
+  delete current;
   return EXIT_SUCCESS;
 }
 
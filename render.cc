@@ -0,0 +1,120 @@
+/*
+ * regame: recycling game - OpenGL sprite renderer
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "render.hh"
+
+#include <stddef.h>
+#include <stdio.h>
+
+// buffer objects need GL 1.5 entry points
+#if defined(GL_VERSION_1_5) && defined(GL_GLEXT_PROTOTYPES)
+#define RENDER_VBO
+#endif
+
+
+/*
+ * Implementation
+ */
+
+GLRenderer::GLRenderer()
+: target(GL_TEXTURE_2D), vbo(0), vboSize(0), drawCalls(0), vertices(0)
+{}
+
+
+void
+GLRenderer::init(GLenum target)
+{
+  this->target = target;
+  vbo = 0;
+  vboSize = 0;
+
+#ifdef RENDER_VBO
+  // the core entry points: GL_ARB_vertex_buffer_object alone only promises
+  // the *ARB ones, so older contexts keep the vertex arrays
+  const char* ver = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  int major, minor;
+  if(ver && sscanf(ver, "%d.%d", &major, &minor) == 2
+  && (major > 1 || (major == 1 && minor >= 5)))
+    glGenBuffers(1, &vbo);
+#endif
+}
+
+
+void
+GLRenderer::draw(const SpriteBatch& batch)
+{
+  drawCalls = vertices = 0;
+  submit(batch);
+}
+
+
+void
+GLRenderer::draw(const SpriteBatch& batch, const vector<DamageRect>& rects)
+{
+  drawCalls = vertices = 0;
+  sub.reserve(batch.verts.capacity() / 4);
+  glEnable(GL_SCISSOR_TEST);
+  for(size_t i = 0; i != rects.size(); ++i)
+  {
+    const DamageRect& r = rects[i];
+    glScissor(r.x, r.y, r.w, r.h);
+    DamageTracker::select(sub, batch, r);
+    submit(sub);
+  }
+  glDisable(GL_SCISSOR_TEST);
+}
+
+
+// accumulates the statistics
+void
+GLRenderer::submit(const SpriteBatch& batch)
+{
+  if(!batch.verts.size()) return;
+  vertices += batch.verts.size();
+
+  const char* base = reinterpret_cast<const char*>(&batch.verts[0]);
+#ifdef RENDER_VBO
+  if(vbo)
+  {
+    // orphan the old storage every frame so we never wait for the GPU
+    size_t size = batch.verts.size() * sizeof(Vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if(size > vboSize) vboSize = size * 2;
+    glBufferData(GL_ARRAY_BUFFER, vboSize, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, base);
+    base = NULL;
+  }
+#endif
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, sizeof(Vertex), base + offsetof(Vertex, x));
+  glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), base + offsetof(Vertex, u));
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex),
+      base + offsetof(Vertex, color));
+
+  glEnable(target);
+  for(size_t i = 0; i != batch.runs.size(); ++i)
+  {
+    const SpriteBatch::Run& run = batch.runs[i];
+    glBindTexture(target, run.tex);
+    glDrawArrays(GL_QUADS, run.first, run.count);
+    ++drawCalls;
+  }
+  glDisable(target);
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+#ifdef RENDER_VBO
+  if(vbo) glBindBuffer(GL_ARRAY_BUFFER, 0);
+#endif
+}
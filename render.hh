@@ -0,0 +1,48 @@
+/*
+ * regame: recycling game - OpenGL sprite renderer
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef render_hh
+#define render_hh
+
+/*
+ * Headers
+ */
+
+#include "batch.hh"
+#include "damage.hh"
+#include <FL/gl.h>
+
+
+/*
+ * Draws a SpriteBatch with one draw call per run out of a single streaming
+ * vertex buffer (or plain vertex arrays when VBOs are not available).
+ */
+
+class GLRenderer
+{
+  GLenum target;
+  GLuint vbo;
+  size_t vboSize;
+  SpriteBatch sub;
+
+  void submit(const SpriteBatch& batch);
+
+public:
+  // statistics of the last batch
+  int drawCalls;
+  int vertices;
+
+  GLRenderer();
+
+  // to be called with a current context
+  void init(GLenum target);
+  void draw(const SpriteBatch& batch);
+
+  // only what overlaps each rectangle, scissored to it
+  void draw(const SpriteBatch& batch, const vector<DamageRect>& rects);
+};
+
+#endif
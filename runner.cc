@@ -0,0 +1,186 @@
+/*
+ * regame: recycling game - multi-core batch world runner
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "runner.hh"
+
+#include <thread>
+#include <mutex>
+
+
+/*
+ * Scheduler
+ */
+
+namespace
+{
+  // job indices [begin, end) owned by a thread, on its own cache line
+  struct alignas(64) JobRange
+  {
+    std::mutex lock;
+    size_t begin;
+    size_t end;
+  };
+
+
+  struct Batch
+  {
+    const vector<Level>* levels;
+    const vector<BatchJob>* jobs;
+    vector<BatchResult>* results;
+    int step;
+    int maxms;
+    bool autopilot;
+    vector<JobRange> ranges;
+
+    Batch(size_t threads)
+    : ranges(threads)
+    {}
+
+    bool pop(size_t self, size_t& job);
+    bool steal(size_t self);
+    bool next(size_t self, size_t& job);
+    void work(size_t self);
+  };
+
+
+  bool
+  Batch::pop(size_t self, size_t& job)
+  {
+    JobRange& r = ranges[self];
+    std::lock_guard<std::mutex> guard(r.lock);
+    if(r.begin == r.end) return false;
+    job = r.begin++;
+    return true;
+  }
+
+
+  bool
+  Batch::steal(size_t self)
+  {
+    // take the back half of the first victim with anything left. Jobs never
+    // get created, so an empty round means we're done
+    for(size_t n = 1; n != ranges.size(); ++n)
+    {
+      JobRange& victim = ranges[(self + n) % ranges.size()];
+      size_t begin, end;
+      {
+	std::lock_guard<std::mutex> guard(victim.lock);
+	if(victim.begin == victim.end) continue;
+	end = victim.end;
+	begin = victim.begin + (victim.end - victim.begin) / 2;
+	victim.end = begin;
+      }
+
+      JobRange& r = ranges[self];
+      std::lock_guard<std::mutex> guard(r.lock);
+      r.begin = begin;
+      r.end = end;
+      return true;
+    }
+    return false;
+  }
+
+
+  bool
+  Batch::next(size_t self, size_t& job)
+  {
+    // other thieves can empty what we stole before we pop it: keep stealing
+    // until there's nothing left anywhere
+    while(!pop(self, job))
+      if(!steal(self)) return false;
+    return true;
+  }
+
+
+  void
+  Batch::work(size_t self)
+  {
+    // this thread's worlds, one per level
+    vector<World*> arena(levels->size(), static_cast<World*>(NULL));
+    Autopilot pilot;
+
+    size_t i;
+    while(next(self, i))
+    {
+      const BatchJob& job = (*jobs)[i];
+      World*& world = arena[job.level];
+      if(!world) world = new World((*levels)[job.level]);
+      else world->reset();
+
+      world->seed(job.seed);
+      world->start();
+
+      BatchResult& res = (*results)[i];
+      res.steps = 0;
+      res.over = false;
+      while(!res.over && world->startms < maxms)
+      {
+	Dir dir = dirNone;
+	if(autopilot)
+	{
+	  bool release = false;
+	  dir = pilot.control(*world, release);
+	  if(release) world->release();
+	}
+	res.over = world->update(step, dir);
+	++res.steps;
+      }
+      res.survival = world->startms;
+      res.score = world->points();
+      res.pts = world->pts;
+    }
+
+    for(size_t l = 0; l != arena.size(); ++l)
+      delete arena[l];
+  }
+}
+
+
+
+/*
+ * Implementation
+ */
+
+Runner::Runner(int threads)
+: threads(threads)
+{
+  if(this->threads < 1) this->threads = std::thread::hardware_concurrency();
+  if(this->threads < 1) this->threads = 1;
+}
+
+
+void
+Runner::run(const vector<Level>& levels, const vector<BatchJob>& jobs,
+    vector<BatchResult>& results, int step, int maxms, bool autopilot) const
+{
+  results.resize(jobs.size());
+
+  Batch batch(threads);
+  batch.levels = &levels;
+  batch.jobs = &jobs;
+  batch.results = &results;
+  batch.step = step;
+  batch.maxms = maxms;
+  batch.autopilot = autopilot;
+
+  // even split to start with: stealing evens out the rest
+  for(int t = 0; t != threads; ++t)
+  {
+    batch.ranges[t].begin = jobs.size() * t / threads;
+    batch.ranges[t].end = jobs.size() * (t + 1) / threads;
+  }
+
+  vector<std::thread> workers;
+  for(int t = 1; t < threads; ++t)
+    workers.push_back(std::thread(&Batch::work, &batch, t));
+  batch.work(0);
+  for(size_t t = 0; t != workers.size(); ++t)
+    workers[t].join();
+}
@@ -0,0 +1,66 @@
+/*
+ * regame: recycling game - multi-core batch world runner
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef runner_hh
+#define runner_hh
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+#include "control.hh"
+
+
+/*
+ * Structures
+ */
+
+// one game: a level (index in the runner's list) and a seed
+struct BatchJob
+{
+  size_t level;
+  unsigned int seed;
+};
+
+
+struct BatchResult
+{
+  int survival;		// msecs until game over (or the time limit)
+  int score;
+  int pts;
+  long steps;
+  bool over;		// reached the game over
+};
+
+
+/*
+ * Runs independent games on all cores, stepping them like the game window
+ * does. Every thread owns a contiguous range of jobs and steals half of the
+ * remaining range of another thread when it runs out; worlds are allocated
+ * per thread and reused across the jobs of the same level, so the threads
+ * share no mutable state except for the job ranges.
+ */
+
+class Runner
+{
+  int threads;
+
+public:
+  // threads = 0: one per core
+  Runner(int threads = 0);
+
+  int size() const
+  { return threads; }
+
+  // results[i] for jobs[i]: step and time limit in msecs. Games are left
+  // alone unless autopilot is set
+  void run(const vector<Level>& levels, const vector<BatchJob>& jobs,
+      vector<BatchResult>& results, int step, int maxms,
+      bool autopilot = false) const;
+};
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * regame: recycling game - scene layout
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "scene.hh"
+
+#include <stdlib.h>
+#include <math.h>
+
+
+/*
+ * Implementation
+ */
+
+size_t
+Scene::reserve(const Level& data, size_t n)
+{
+  order.reserve(n);
+  typeStart.reserve(data.objs.size() + 1);
+
+  // background, containers, player and shadow, grabbed object
+  return 1 + data.cnts.size() + 2 + 1 + n;
+}
+
+
+void
+Scene::build(SpriteBatch& batch, const Level& data, const Snapshot& snap,
+    float alpha, int step, Random& rnd)
+{
+  float playerX = snap.prevX + (snap.playerX - snap.prevX) * alpha;
+  double ms = snap.startms + alpha * step;
+
+  // background
+  batch.add(data.back, Affine(), Point2f(0, 0));
+
+  // containers
+  for(size_t i = 0; i != data.cnts.size(); ++i)
+  {
+    if(snap.shakeStart[i] < snap.startms
+    && snap.shakeStart[i] + data.shakeLen < snap.startms)
+      batch.add(data.cnts[i].s, Affine(), data.cnts[i].pos);
+    else
+      batch.add(data.cnts[i].s, Affine(), Point2f(
+	      data.cnts[i].pos.x + rnd() % data.shake - data.shake / 2,
+	      data.cnts[i].pos.y + rnd() % data.shake - data.shake / 2));
+  }
+
+  // player
+  int playerFrame = (!snap.playerSX? 0:
+      static_cast<int>(ms / data.playerFpms)
+		   % data.playerAnim.size());
+
+  if(!oldDir || snap.playerSX)
+    oldDir = (snap.playerSX >= 0? 1: 2);
+
+  const Sprite& ps = data.playerAnim[playerFrame];
+  Affine pm = Affine::translate(playerX, data.player.y);
+  if(oldDir == 2) pm = pm * Affine::scale(-1, 1);
+  batch.add(ps, pm * Affine::scale(1, -0.3), Point2f(-ps.w / 2, 0),
+      0, 0, 0, 0.3);
+  batch.add(ps, pm, Point2f(-ps.w / 2, 0));
+
+  // grabbed particle
+  if(snap.grabbed)
+  {
+    const Sprite& s = data.objs[snap.grabType];
+    batch.add(s, Affine::translate(playerX - ps.w / 2,
+	    data.player.y + ps.h - s.h / 2) * Affine::scale(0.5, 0.5),
+	Point2f(0, 0));
+  }
+
+  // particles, grouped by type
+  size_t count = snap.x.size();
+  typeStart.assign(data.objs.size() + 1, 0);
+  for(size_t i = 0; i != count; ++i)
+    ++typeStart[snap.type[i] + 1];
+  for(size_t t = 1; t < typeStart.size(); ++t)
+    typeStart[t] += typeStart[t - 1];
+  order.resize(count);
+  for(size_t i = 0; i != count; ++i)
+    order[typeStart[snap.type[i]]++] = i;
+
+  for(size_t n = 0; n != order.size(); ++n)
+  {
+    size_t i = order[n];
+    const Sprite& s = data.objs[snap.type[i]];
+    float y = snap.prevY[i] + (snap.y[i] - snap.prevY[i]) * alpha;
+    float a = (snap.pgrabbed[i] || (y < data.baseline)? 0.5: 1);
+    double r = snap.rand[i] + ms / (100. +
+	(static_cast<double>(snap.rand[i]) / Random::max * 160. - 90.));
+    r = fmod(r, 360.);
+    if(snap.rand[i] % 2) r = -r;
+
+    batch.add(s, Affine::translate(snap.x[i], y) * Affine::rotate(r),
+	Point2f(-s.w / 2, -s.h / 2), a);
+  }
+}
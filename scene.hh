@@ -0,0 +1,47 @@
+/*
+ * regame: recycling game - scene layout
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef scene_hh
+#define scene_hh
+
+/*
+ * Headers
+ */
+
+#include "batch.hh"
+#include "sim.hh"
+
+
+/*
+ * The sprites of a frame, for any renderer: background, containers, the
+ * player over its shadow, the grabbed object and the particles (grouped by
+ * type to keep the texture runs long), blended by alpha between the last
+ * two steps of a snapshot. Text is left to the caller.
+ */
+
+class Scene
+{
+  int oldDir;			// the player keeps facing its last way
+  vector<unsigned int> order;
+  vector<unsigned int> typeStart;
+
+public:
+  Scene()
+  : oldDir(0)
+  {}
+
+  void reset()
+  { oldDir = 0; }
+
+  // room for n particles: returns the quads of such a frame
+  size_t reserve(const Level& data, size_t n);
+
+  // step in msecs; the containers shake by the numbers of rnd
+  void build(SpriteBatch& batch, const Level& data, const Snapshot& snap,
+      float alpha, int step, Random& rnd);
+};
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * regame: recycling game - simulation thread
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "sim.hh"
+#include "timing.hh"
+
+#include <stdio.h>
+#include <time.h>
+
+
+/*
+ * Implementation
+ */
+
+void
+Snapshot::reserve(size_t n)
+{
+  x.reserve(n);
+  y.reserve(n);
+  prevY.reserve(n);
+  type.reserve(n);
+  rand.reserve(n);
+  pgrabbed.reserve(n);
+}
+
+
+void
+Snapshot::capture(const World& world)
+{
+  started = world.started;
+  startms = world.startms;
+  score = world.score;
+  lives = world.lives;
+  mms = world.mms;
+  mmd = world.mmd;
+  pts = world.pts;
+
+  playerX = world.data.player.x;
+  prevX = world.prevX;
+  playerSX = world.data.player.sx;
+  grabbed = world.grabbed;
+  grabType = world.grabType;
+
+  // assign() keeps the capacity: no allocations once warmed up
+  const ParticlePool& p = world.particles;
+  x.assign(p.x.begin(), p.x.end());
+  y.assign(p.y.begin(), p.y.end());
+  prevY.assign(p.prevY.begin(), p.prevY.end());
+  type.assign(p.type.begin(), p.type.end());
+  rand.assign(p.rand.begin(), p.rand.end());
+  pgrabbed.assign(p.grabbed.begin(), p.grabbed.end());
+
+  shakeStart.resize(world.data.cnts.size());
+  for(size_t i = 0; i != shakeStart.size(); ++i)
+    shakeStart[i] = world.data.cnts[i].shakeStart;
+}
+
+
+SimThread::SimThread(const Level& data, int step, float speed,
+    Controller* pilot, const char* recordFile)
+: world(data), step(step), period(step / 1000. / speed), pilot(pilot),
+  recordFile(recordFile), quit(false), key(0), dir(dirNone),
+  recording(false), overs(0), steps(0), busy(0)
+{
+  // nothing to allocate while stepping
+  size_t n = particleCapacity(data, step);
+  world.particles.reserve(n);
+  for(int i = 0; i != 3; ++i)
+    snaps.buffer(i).reserve(n);
+
+  world.reset();
+  snaps.write().capture(world);
+  snaps.publish();
+  thread = std::thread(&SimThread::run, this);
+}
+
+
+SimThread::~SimThread()
+{
+  quit = true;
+  thread.join();
+  endRecord();
+  delete pilot;
+}
+
+
+bool
+SimThread::send(SimCommand cmd, int key, Dir dir)
+{
+  SimInput in;
+  in.cmd = cmd;
+  in.key = key;
+  in.dir = dir;
+  return !input.push(in);
+}
+
+
+void
+SimThread::endRecord()
+{
+  if(!recording) return;
+  recording = false;
+  record.end(world);
+  if(record.save(recordFile))
+    fprintf(stderr, "cannot write input log %s\n", recordFile);
+}
+
+
+void
+SimThread::apply(const SimInput& in)
+{
+  switch(in.cmd)
+  {
+  case simKeyDown:
+    key = in.key;
+    dir = in.dir;
+    if(recording) record.add(world.startms, inKeyDown, key, dir);
+    break;
+
+  case simKeyUp:
+    if(recording) record.add(world.startms, inKeyUp, in.key);
+    if(key == in.key)
+    {
+      key = 0;
+      dir = dirNone;
+    }
+    break;
+
+  case simRelease:
+    if(!world.started) break;
+    if(recording) record.add(world.startms, inRelease);
+    world.release();
+    break;
+
+  case simStart:
+  {
+    if(world.started) break;
+    unsigned int seed = time(NULL) ^ static_cast<unsigned int>(monotonic() * 1e6);
+    world.seed(seed);
+    world.start();
+
+    if(recordFile)
+    {
+      record.clear();
+      record.level = world.data.name;
+      record.seed = seed;
+      record.step = step;
+      if(key) record.add(0, inKeyDown, key, dir);
+      recording = true;
+    }
+    break;
+  }
+
+  case simReset:
+    endRecord();
+    world.reset();
+    break;
+  }
+}
+
+
+void
+SimThread::run()
+{
+  int maxSteps = maxCatchup / (period * 1000.) + 0.5;
+  if(maxSteps < 1) maxSteps = 1;
+  Dir pilotDir = dirNone;
+  double next = monotonic();
+
+  while(!quit)
+  {
+    double now = monotonic();
+    if(now < next)
+    {
+      sleepUntil(next);
+      now = monotonic();
+    }
+    double late = (now - next) * 1e3;
+
+    bool dirty = false;
+    SimInput in;
+    while(input.pop(in))
+    {
+      apply(in);
+      dirty = true;
+    }
+    if(!world.started)
+    {
+      // idle: just poll for input, at the frame rate rather than every step
+      next = now + idleWait / 1000.;
+      pilotDir = dirNone;
+      if(!dirty) continue;
+    }
+    else
+    {
+      double start = monotonic();
+      int n = 0;
+      for(; n < maxSteps && next <= now; ++n, next += period)
+      {
+	Dir d = dir;
+	if(pilot)
+	{
+	  // log the pilot's decisions as key presses
+	  bool release = false;
+	  d = pilot->control(world, release);
+	  if(recording && d != pilotDir)
+	  {
+	    if(pilotDir) record.add(world.startms, inKeyUp, pilotDir);
+	    if(d) record.add(world.startms, inKeyDown, d, d);
+	  }
+	  pilotDir = d;
+	  if(release)
+	  {
+	    if(recording) record.add(world.startms, inRelease);
+	    world.release();
+	  }
+	}
+
+	if(world.update(step, d))
+	{
+	  ++overs;
+	  endRecord();
+	}
+      }
+
+      // after a stall, drop the excess instead of trying to catch up
+      if(next <= now) next = now + period;
+      steps += n;
+      busy += (monotonic() - start) * 1e3;
+    }
+
+    Snapshot& snap = snaps.write();
+    snap.capture(world);
+    snap.overs = overs;
+    snap.time = (world.started? next - period: now);
+    snap.steps = steps;
+    snap.busy = busy;
+    snap.late = late;
+    snaps.publish();
+  }
+}
@@ -0,0 +1,150 @@
+/*
+ * regame: recycling game - simulation thread
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef sim_hh
+#define sim_hh
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+#include "control.hh"
+#include "input.hh"
+#include "sync.hh"
+
+#include <thread>
+
+
+/*
+ * Structures
+ */
+
+// what's needed to draw a frame, copied out of the world after each tick
+struct Snapshot
+{
+  // game state
+  bool started;
+  int startms;
+  int score;
+  int lives;
+  float mms;
+  float mmd;
+  int pts;
+  int overs;		// game overs so far
+
+  // player and the grabbed object
+  float playerX;
+  float prevX;
+  float playerSX;
+  bool grabbed;
+  int grabType;
+
+  // particles: current and previous step
+  vector<float> x;
+  vector<float> y;
+  vector<float> prevY;
+  vector<ObjType> type;
+  vector<int> rand;
+  vector<int> pgrabbed;
+
+  // per container
+  vector<int> shakeStart;
+
+  // timing: monotonic() of the last step, totals for profiling
+  double time;
+  long steps;
+  double busy;		// msecs spent stepping
+  double late;		// last wake-up past its deadline, msecs
+
+  Snapshot()
+  : started(false), startms(0), score(0), lives(0), mms(0), mmd(0), pts(0),
+    overs(0), playerX(0), prevX(0), playerSX(0), grabbed(false),
+    grabType(0), time(0), steps(0), busy(0), late(0)
+  {}
+
+  // room for n particles
+  void reserve(size_t n);
+
+  void capture(const World& world);
+};
+
+
+enum SimCommand
+{
+  simKeyDown,		// key, dir
+  simKeyUp,		// key
+  simRelease,
+  simStart,
+  simReset
+};
+
+
+struct SimInput
+{
+  SimCommand cmd;
+  int key;
+  Dir dir;
+};
+
+
+/*
+ * Steps its own world in fixed steps on a separate thread, dropping the
+ * excess after stalls, and publishes a snapshot after every tick. Input is
+ * queued and applied between steps; the pilot, if any, plays instead of the
+ * keys. Recording follows each game from start to game over or reset.
+ */
+
+class SimThread
+{
+  World world;
+  int step;
+  double period;	// real secs per step
+  Controller* pilot;
+  const char* recordFile;
+
+  SpscQueue<SimInput, 256> input;
+  TripleBuffer<Snapshot> snaps;
+  std::atomic<bool> quit;
+  std::thread thread;
+
+  // owned by the thread
+  int key;
+  Dir dir;
+  InputLog record;
+  bool recording;
+  int overs;
+  long steps;
+  double busy;
+
+  void run();
+  void apply(const SimInput& in);
+  void endRecord();
+
+public:
+  // simulated msecs per tick, at most
+  static const int maxCatchup = 250;
+
+  // real msecs between polls for input when no game is running (a frame)
+  static const int idleWait = 16;
+
+  // takes ownership of the pilot
+  SimThread(const Level& data, int step, float speed = 1,
+      Controller* pilot = NULL, const char* recordFile = NULL);
+  ~SimThread();
+
+  // returns true if the queue is full
+  bool send(SimCommand cmd, int key = 0, Dir dir = dirNone);
+
+  // latest snapshot, valid until the next call
+  bool pending() const
+  { return snaps.pending(); }
+
+  const Snapshot& read()
+  { return snaps.read(); }
+};
+
+#endif
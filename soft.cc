@@ -0,0 +1,754 @@
+/*
+ * regame: recycling game - software sprite renderer
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "soft.hh"
+#include "atlas.hh"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SOFT_X86
+#include <immintrin.h>
+#endif
+
+
+/*
+ * Kernels
+ */
+
+namespace
+{
+  // one row of a quad: texel coordinates at the center of the first pixel
+  // and their steps along the row
+  struct Span
+  {
+    const SoftTexture* tex;
+    float u, v;
+    float du, dv;
+    float color[4];	// modulation, alpha also scaled by 1/255
+  };
+
+  typedef void (*SpanKernel)(uint32_t*, int, const Span&);
+  typedef void (*BlitKernel)(uint32_t*, const uint32_t*, int, const float*);
+
+
+  inline int
+  clampi(int v, int lo, int hi)
+  {
+    return (v < lo? lo: (v > hi? hi: v));
+  }
+
+
+  inline float
+  channel(uint32_t p, int n)
+  {
+    return static_cast<float>((p >> (n * 8)) & 0xff);
+  }
+
+
+  // over the destination: r, g, b in 0-255, a in 0-1
+  inline uint32_t
+  blend1(uint32_t d, float r, float g, float b, float a)
+  {
+    float dr = channel(d, 0);
+    float dg = channel(d, 1);
+    float db = channel(d, 2);
+    uint32_t or_ = static_cast<uint32_t>(dr + (r - dr) * a + 0.5f);
+    uint32_t og = static_cast<uint32_t>(dg + (g - dg) * a + 0.5f);
+    uint32_t ob = static_cast<uint32_t>(db + (b - db) * a + 0.5f);
+    return (or_ | (og << 8) | (ob << 16) | 0xff000000);
+  }
+
+
+  // like GL_LINEAR with GL_CLAMP_TO_EDGE
+  inline void
+  sample(const SoftTexture& t, float x, float y, float c[4])
+  {
+    float x0 = floorf(x);
+    float y0 = floorf(y);
+    float fx = x - x0;
+    float fy = y - y0;
+    int xa = clampi(static_cast<int>(x0), 0, t.w - 1);
+    int xb = clampi(static_cast<int>(x0) + 1, 0, t.w - 1);
+    int ya = clampi(static_cast<int>(y0), 0, t.h - 1);
+    int yb = clampi(static_cast<int>(y0) + 1, 0, t.h - 1);
+    uint32_t p00 = t.px[ya * t.w + xa];
+    uint32_t p10 = t.px[ya * t.w + xb];
+    uint32_t p01 = t.px[yb * t.w + xa];
+    uint32_t p11 = t.px[yb * t.w + xb];
+    for(int n = 0; n != 4; ++n)
+    {
+      float top = channel(p00, n) + (channel(p10, n) - channel(p00, n)) * fx;
+      float bot = channel(p01, n) + (channel(p11, n) - channel(p01, n)) * fx;
+      c[n] = top + (bot - top) * fy;
+    }
+  }
+
+
+  void
+  spanScalar(uint32_t* dst, int n, const Span& s)
+  {
+    for(int i = 0; i != n; ++i)
+    {
+      float c[4];
+      sample(*s.tex, s.u + i * s.du - 0.5f, s.v + i * s.dv - 0.5f, c);
+      dst[i] = blend1(dst[i], c[0] * s.color[0], c[1] * s.color[1],
+	  c[2] * s.color[2], c[3] * s.color[3]);
+    }
+  }
+
+
+  void
+  blitScalar(uint32_t* dst, const uint32_t* src, int n, const float* color)
+  {
+    for(int i = 0; i != n; ++i)
+    {
+      uint32_t p = src[i];
+      dst[i] = blend1(dst[i], channel(p, 0) * color[0],
+	  channel(p, 1) * color[1], channel(p, 2) * color[2],
+	  channel(p, 3) * color[3]);
+    }
+  }
+
+
+#ifdef SOFT_X86
+  /*
+   * SSE2: four pixels at once, one register per channel. There's no gather
+   * nor floor: texels are fetched one by one.
+   */
+
+  __attribute__((target("sse2"))) inline void
+  channels4(__m128i p, __m128& r, __m128& g, __m128& b, __m128& a)
+  {
+    const __m128i mask = _mm_set1_epi32(0xff);
+    r = _mm_cvtepi32_ps(_mm_and_si128(p, mask));
+    g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), mask));
+    b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), mask));
+    a = _mm_cvtepi32_ps(_mm_srli_epi32(p, 24));
+  }
+
+
+  __attribute__((target("sse2"))) inline __m128i
+  blend4(__m128i d, __m128 r, __m128 g, __m128 b, __m128 a)
+  {
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 dr, dg, db, da;
+    channels4(d, dr, dg, db, da);
+    __m128i or_ = _mm_cvttps_epi32(_mm_add_ps(
+	    _mm_add_ps(dr, _mm_mul_ps(_mm_sub_ps(r, dr), a)), half));
+    __m128i og = _mm_cvttps_epi32(_mm_add_ps(
+	    _mm_add_ps(dg, _mm_mul_ps(_mm_sub_ps(g, dg), a)), half));
+    __m128i ob = _mm_cvttps_epi32(_mm_add_ps(
+	    _mm_add_ps(db, _mm_mul_ps(_mm_sub_ps(b, db), a)), half));
+    return _mm_or_si128(_mm_or_si128(or_, _mm_slli_epi32(og, 8)),
+	_mm_or_si128(_mm_slli_epi32(ob, 16), _mm_set1_epi32(0xff000000)));
+  }
+
+
+  __attribute__((target("sse2"))) inline __m128
+  floor4(__m128 x)
+  {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1)));
+  }
+
+
+  __attribute__((target("sse2"))) inline __m128
+  lerp4(__m128 a, __m128 b, __m128 f)
+  {
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f));
+  }
+
+
+  __attribute__((target("sse2"))) void
+  spanSSE2(uint32_t* dst, int n, const Span& s)
+  {
+    const SoftTexture& t = *s.tex;
+    const __m128 step = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1);
+    const __m128 xmax = _mm_set1_ps(t.w - 1);
+    const __m128 ymax = _mm_set1_ps(t.h - 1);
+    const __m128 u = _mm_set1_ps(s.u), du = _mm_set1_ps(s.du);
+    const __m128 v = _mm_set1_ps(s.v), dv = _mm_set1_ps(s.dv);
+    const __m128 cr = _mm_set1_ps(s.color[0]), cg = _mm_set1_ps(s.color[1]);
+    const __m128 cb = _mm_set1_ps(s.color[2]), ca = _mm_set1_ps(s.color[3]);
+
+    int i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+      __m128 fi = _mm_add_ps(_mm_set1_ps(i), step);
+      __m128 x = _mm_sub_ps(_mm_add_ps(u, _mm_mul_ps(fi, du)), half);
+      __m128 y = _mm_sub_ps(_mm_add_ps(v, _mm_mul_ps(fi, dv)), half);
+      __m128 x0 = floor4(x);
+      __m128 y0 = floor4(y);
+      __m128 fx = _mm_sub_ps(x, x0);
+      __m128 fy = _mm_sub_ps(y, y0);
+
+      int xa[4], xb[4], ya[4], yb[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(xa), _mm_cvttps_epi32(
+	      _mm_min_ps(_mm_max_ps(x0, zero), xmax)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(xb), _mm_cvttps_epi32(
+	      _mm_min_ps(_mm_max_ps(_mm_add_ps(x0, one), zero), xmax)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(ya), _mm_cvttps_epi32(
+	      _mm_min_ps(_mm_max_ps(y0, zero), ymax)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(yb), _mm_cvttps_epi32(
+	      _mm_min_ps(_mm_max_ps(_mm_add_ps(y0, one), zero), ymax)));
+
+      const uint32_t* px = &t.px[0];
+      __m128i p00 = _mm_setr_epi32(px[ya[0] * t.w + xa[0]],
+	  px[ya[1] * t.w + xa[1]], px[ya[2] * t.w + xa[2]],
+	  px[ya[3] * t.w + xa[3]]);
+      __m128i p10 = _mm_setr_epi32(px[ya[0] * t.w + xb[0]],
+	  px[ya[1] * t.w + xb[1]], px[ya[2] * t.w + xb[2]],
+	  px[ya[3] * t.w + xb[3]]);
+      __m128i p01 = _mm_setr_epi32(px[yb[0] * t.w + xa[0]],
+	  px[yb[1] * t.w + xa[1]], px[yb[2] * t.w + xa[2]],
+	  px[yb[3] * t.w + xa[3]]);
+      __m128i p11 = _mm_setr_epi32(px[yb[0] * t.w + xb[0]],
+	  px[yb[1] * t.w + xb[1]], px[yb[2] * t.w + xb[2]],
+	  px[yb[3] * t.w + xb[3]]);
+
+      __m128 r00, g00, b00, a00, r10, g10, b10, a10;
+      __m128 r01, g01, b01, a01, r11, g11, b11, a11;
+      channels4(p00, r00, g00, b00, a00);
+      channels4(p10, r10, g10, b10, a10);
+      channels4(p01, r01, g01, b01, a01);
+      channels4(p11, r11, g11, b11, a11);
+      __m128 r = lerp4(lerp4(r00, r10, fx), lerp4(r01, r11, fx), fy);
+      __m128 g = lerp4(lerp4(g00, g10, fx), lerp4(g01, g11, fx), fy);
+      __m128 b = lerp4(lerp4(b00, b10, fx), lerp4(b01, b11, fx), fy);
+      __m128 a = lerp4(lerp4(a00, a10, fx), lerp4(a01, a11, fx), fy);
+
+      __m128i* d = reinterpret_cast<__m128i*>(dst + i);
+      _mm_storeu_si128(d, blend4(_mm_loadu_si128(d), _mm_mul_ps(r, cr),
+	      _mm_mul_ps(g, cg), _mm_mul_ps(b, cb), _mm_mul_ps(a, ca)));
+    }
+
+    if(i != n)
+    {
+      Span rest = s;
+      rest.u += i * s.du;
+      rest.v += i * s.dv;
+      spanScalar(dst + i, n - i, rest);
+    }
+  }
+
+
+  __attribute__((target("sse2"))) void
+  blitSSE2(uint32_t* dst, const uint32_t* src, int n, const float* color)
+  {
+    const __m128 cr = _mm_set1_ps(color[0]), cg = _mm_set1_ps(color[1]);
+    const __m128 cb = _mm_set1_ps(color[2]), ca = _mm_set1_ps(color[3]);
+
+    int i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+      __m128 r, g, b, a;
+      channels4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)),
+	  r, g, b, a);
+      __m128i* d = reinterpret_cast<__m128i*>(dst + i);
+      _mm_storeu_si128(d, blend4(_mm_loadu_si128(d), _mm_mul_ps(r, cr),
+	      _mm_mul_ps(g, cg), _mm_mul_ps(b, cb), _mm_mul_ps(a, ca)));
+    }
+    blitScalar(dst + i, src + i, n - i, color);
+  }
+
+
+  /*
+   * AVX2: eight pixels at once, with hardware gathers and floor.
+   */
+
+  __attribute__((target("avx2"))) inline void
+  channels8(__m256i p, __m256& r, __m256& g, __m256& b, __m256& a)
+  {
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    r = _mm256_cvtepi32_ps(_mm256_and_si256(p, mask));
+    g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, 8), mask));
+    b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, 16), mask));
+    a = _mm256_cvtepi32_ps(_mm256_srli_epi32(p, 24));
+  }
+
+
+  __attribute__((target("avx2"))) inline __m256
+  lerp8(__m256 a, __m256 b, __m256 f)
+  {
+    return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), f));
+  }
+
+
+  __attribute__((target("avx2"))) inline __m256i
+  blend8(__m256i d, __m256 r, __m256 g, __m256 b, __m256 a)
+  {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    __m256 dr, dg, db, da;
+    channels8(d, dr, dg, db, da);
+    __m256i or_ = _mm256_cvttps_epi32(_mm256_add_ps(lerp8(dr, r, a), half));
+    __m256i og = _mm256_cvttps_epi32(_mm256_add_ps(lerp8(dg, g, a), half));
+    __m256i ob = _mm256_cvttps_epi32(_mm256_add_ps(lerp8(db, b, a), half));
+    return _mm256_or_si256(_mm256_or_si256(or_, _mm256_slli_epi32(og, 8)),
+	_mm256_or_si256(_mm256_slli_epi32(ob, 16),
+	    _mm256_set1_epi32(0xff000000)));
+  }
+
+
+  __attribute__((target("avx2"))) void
+  spanAVX2(uint32_t* dst, int n, const Span& s)
+  {
+    const SoftTexture& t = *s.tex;
+    const int* px = reinterpret_cast<const int*>(&t.px[0]);
+    const __m256 step = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i xmax = _mm256_set1_epi32(t.w - 1);
+    const __m256i ymax = _mm256_set1_epi32(t.h - 1);
+    const __m256i stride = _mm256_set1_epi32(t.w);
+    const __m256 u = _mm256_set1_ps(s.u), du = _mm256_set1_ps(s.du);
+    const __m256 v = _mm256_set1_ps(s.v), dv = _mm256_set1_ps(s.dv);
+    const __m256 cr = _mm256_set1_ps(s.color[0]);
+    const __m256 cg = _mm256_set1_ps(s.color[1]);
+    const __m256 cb = _mm256_set1_ps(s.color[2]);
+    const __m256 ca = _mm256_set1_ps(s.color[3]);
+
+    int i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+      __m256 fi = _mm256_add_ps(_mm256_set1_ps(i), step);
+      __m256 x = _mm256_sub_ps(_mm256_add_ps(u, _mm256_mul_ps(fi, du)), half);
+      __m256 y = _mm256_sub_ps(_mm256_add_ps(v, _mm256_mul_ps(fi, dv)), half);
+      __m256 x0 = _mm256_floor_ps(x);
+      __m256 y0 = _mm256_floor_ps(y);
+      __m256 fx = _mm256_sub_ps(x, x0);
+      __m256 fy = _mm256_sub_ps(y, y0);
+
+      __m256i ix = _mm256_cvttps_epi32(x0);
+      __m256i iy = _mm256_cvttps_epi32(y0);
+      __m256i xa = _mm256_min_epi32(_mm256_max_epi32(ix, zero), xmax);
+      __m256i xb = _mm256_min_epi32(_mm256_max_epi32(
+	      _mm256_add_epi32(ix, one), zero), xmax);
+      __m256i ya = _mm256_mullo_epi32(_mm256_min_epi32(
+	      _mm256_max_epi32(iy, zero), ymax), stride);
+      __m256i yb = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(
+		  _mm256_add_epi32(iy, one), zero), ymax), stride);
+
+      __m256 r00, g00, b00, a00, r10, g10, b10, a10;
+      __m256 r01, g01, b01, a01, r11, g11, b11, a11;
+      channels8(_mm256_i32gather_epi32(px, _mm256_add_epi32(ya, xa), 4),
+	  r00, g00, b00, a00);
+      channels8(_mm256_i32gather_epi32(px, _mm256_add_epi32(ya, xb), 4),
+	  r10, g10, b10, a10);
+      channels8(_mm256_i32gather_epi32(px, _mm256_add_epi32(yb, xa), 4),
+	  r01, g01, b01, a01);
+      channels8(_mm256_i32gather_epi32(px, _mm256_add_epi32(yb, xb), 4),
+	  r11, g11, b11, a11);
+      __m256 r = lerp8(lerp8(r00, r10, fx), lerp8(r01, r11, fx), fy);
+      __m256 g = lerp8(lerp8(g00, g10, fx), lerp8(g01, g11, fx), fy);
+      __m256 b = lerp8(lerp8(b00, b10, fx), lerp8(b01, b11, fx), fy);
+      __m256 a = lerp8(lerp8(a00, a10, fx), lerp8(a01, a11, fx), fy);
+
+      __m256i* d = reinterpret_cast<__m256i*>(dst + i);
+      _mm256_storeu_si256(d, blend8(_mm256_loadu_si256(d),
+	      _mm256_mul_ps(r, cr), _mm256_mul_ps(g, cg), _mm256_mul_ps(b, cb),
+	      _mm256_mul_ps(a, ca)));
+    }
+
+    if(i != n)
+    {
+      Span rest = s;
+      rest.u += i * s.du;
+      rest.v += i * s.dv;
+      spanScalar(dst + i, n - i, rest);
+    }
+  }
+
+
+  __attribute__((target("avx2"))) void
+  blitAVX2(uint32_t* dst, const uint32_t* src, int n, const float* color)
+  {
+    const __m256 cr = _mm256_set1_ps(color[0]);
+    const __m256 cg = _mm256_set1_ps(color[1]);
+    const __m256 cb = _mm256_set1_ps(color[2]);
+    const __m256 ca = _mm256_set1_ps(color[3]);
+
+    int i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+      __m256 r, g, b, a;
+      channels8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)),
+	  r, g, b, a);
+      __m256i* d = reinterpret_cast<__m256i*>(dst + i);
+      _mm256_storeu_si256(d, blend8(_mm256_loadu_si256(d),
+	      _mm256_mul_ps(r, cr), _mm256_mul_ps(g, cg), _mm256_mul_ps(b, cb),
+	      _mm256_mul_ps(a, ca)));
+    }
+    blitScalar(dst + i, src + i, n - i, color);
+  }
+#endif
+
+
+  struct KernelEntry
+  {
+    const char* name;
+    SpanKernel span;
+    BlitKernel blit;
+  };
+
+  const KernelEntry kernels[] =
+  {
+#ifdef SOFT_X86
+    {"avx2", spanAVX2, blitAVX2},
+    {"sse2", spanSSE2, blitSSE2},
+#endif
+    {"scalar", spanScalar, blitScalar}
+  };
+
+  const size_t nKernels = sizeof(kernels) / sizeof(*kernels);
+  const KernelEntry* selected = NULL;
+
+
+  bool
+  available(const KernelEntry& k)
+  {
+#ifdef SOFT_X86
+    if(k.span == spanAVX2) return __builtin_cpu_supports("avx2");
+    if(k.span == spanSSE2) return __builtin_cpu_supports("sse2");
+#endif
+    return true;
+  }
+
+
+  const KernelEntry*
+  select()
+  {
+    // the best one we can run
+    if(!selected)
+    {
+      size_t i = 0;
+      while(!available(kernels[i])) ++i;
+      selected = kernels + i;
+    }
+    return selected;
+  }
+
+
+  // narrow [a, b) to the x where 0 <= v0 + x * dv < 1: returns true if empty
+  bool
+  narrow(double v0, double dv, int& a, int& b)
+  {
+    if(!dv) return (v0 < 0 || v0 >= 1);
+
+    double lo = -v0 / dv;
+    double hi = (1 - v0) / dv;
+    double first = (dv > 0? ceil(lo): floor(hi) + 1);
+    double last = (dv > 0? ceil(hi): floor(lo) + 1);
+    if(first > a) a = (first < b? static_cast<int>(first): b);
+    if(last < b) b = (last > a? static_cast<int>(last): a);
+    return (a >= b);
+  }
+
+
+  // within tolerance of a whole number
+  inline bool
+  whole(float v, int& i)
+  {
+    float r = floorf(v + 0.5f);
+    i = static_cast<int>(r);
+    return (fabsf(v - r) < 1e-3f);
+  }
+}
+
+
+
+/*
+ * Implementation
+ */
+
+SoftRenderer::SoftRenderer()
+: w(0), h(0), drawCalls(0), vertices(0)
+{}
+
+
+void
+SoftRenderer::resize(int w, int h)
+{
+  this->w = w;
+  this->h = h;
+  fb.assign(w * h, 0xff000000);
+
+  DamageRect r = {0, 0, w, h};
+  screen.assign(1, r);
+}
+
+
+unsigned int
+SoftRenderer::upload(const unsigned char* px, int w, int h, int chans, int tw)
+{
+  // names are reused, as GL does
+  unsigned int name;
+  if(unused.size())
+  {
+    name = unused.back();
+    unused.pop_back();
+  }
+  else
+  {
+    textures.push_back(SoftTexture());
+    name = textures.size();
+  }
+
+  SoftTexture& t = textures[name - 1];
+  t.w = w;
+  t.h = h;
+  t.opaque = true;
+  t.px.resize(w * h);
+  for(int y = 0; y != h; ++y)
+  {
+    const unsigned char* src = px + y * tw * chans;
+    uint32_t* dst = &t.px[y * w];
+    for(int x = 0; x != w; ++x, src += chans)
+    {
+      uint32_t a = (chans == 4? src[3]: 255);
+      dst[x] = (src[0] | (src[1] << 8) | (src[2] << 16) | (a << 24));
+      if(a != 255) t.opaque = false;
+    }
+  }
+  return name;
+}
+
+
+void
+SoftRenderer::release(unsigned int name)
+{
+  if(!name || name > textures.size() || !textures[name - 1].w)
+    return;
+
+  SoftTexture& t = textures[name - 1];
+  vector<uint32_t>().swap(t.px);
+  t.w = t.h = 0;
+  unused.push_back(name);
+}
+
+
+void
+SoftRenderer::quad(const Vertex* q, const SoftTexture& tex,
+    const DamageRect& clip)
+{
+  // a parallelogram: s runs along the first edge, t along the last, both
+  // from 0 to 1
+  double ex = q[1].x - q[0].x, ey = q[1].y - q[0].y;
+  double fx = q[3].x - q[0].x, fy = q[3].y - q[0].y;
+  double det = ex * fy - ey * fx;
+  if(fabs(det) < 1e-9) return;
+
+  float x0 = q[0].x, x1 = q[0].x;
+  float y0 = q[0].y, y1 = q[0].y;
+  for(int n = 1; n != 4; ++n)
+  {
+    x0 = std::min(x0, q[n].x);
+    x1 = std::max(x1, q[n].x);
+    y0 = std::min(y0, q[n].y);
+    y1 = std::max(y1, q[n].y);
+  }
+  int xmin = std::max(clip.x, static_cast<int>(floorf(x0)));
+  int xmax = std::min(clip.x + clip.w, static_cast<int>(ceilf(x1)));
+  int ymin = std::max(clip.y, static_cast<int>(floorf(y0)));
+  int ymax = std::min(clip.y + clip.h, static_cast<int>(ceilf(y1)));
+  if(xmin >= xmax || ymin >= ymax) return;
+
+  // s and t per pixel, texels per s and t
+  double dsx = fy / det, dsy = -fx / det;
+  double dtx = -ey / det, dty = ex / det;
+  double su = q[1].u - q[0].u, sv = q[1].v - q[0].v;
+  double tu = q[3].u - q[0].u, tv = q[3].v - q[0].v;
+
+  Span sp;
+  sp.tex = &tex;
+  sp.du = dsx * su + dtx * tu;
+  sp.dv = dsx * sv + dtx * tv;
+  for(int n = 0; n != 3; ++n)
+    sp.color[n] = q[0].color[n] / 255.f;
+  sp.color[3] = q[0].color[3] / (255.f * 255.f);
+
+  const KernelEntry* k = select();
+  bool white = (q[0].color[0] == 255 && q[0].color[1] == 255
+      && q[0].color[2] == 255 && q[0].color[3] == 255);
+  bool unit = (fabsf(sp.du - 1) < 1e-5f && fabsf(sp.dv) < 1e-5f);
+
+  for(int y = ymin; y != ymax; ++y)
+  {
+    // s and t at the center of the pixel in column 0
+    double px = 0.5 - q[0].x, py = y + 0.5 - q[0].y;
+    double s = px * dsx + py * dsy;
+    double t = px * dtx + py * dty;
+    int a = xmin, b = xmax;
+    if(narrow(s, dsx, a, b) || narrow(t, dtx, a, b)) continue;
+
+    double sa = s + a * dsx, ta = t + a * dtx;
+    sp.u = q[0].u + sa * su + ta * tu;
+    sp.v = q[0].v + sa * sv + ta * tv;
+    uint32_t* dst = &fb[y * w + a];
+
+    // texels one to one: no filtering needed
+    int tx, ty;
+    if(unit && whole(sp.u - 0.5f, tx) && whole(sp.v - 0.5f, ty)
+    && tx >= 0 && tx + (b - a) <= tex.w && ty >= 0 && ty < tex.h)
+    {
+      const uint32_t* src = &tex.px[ty * tex.w + tx];
+      if(tex.opaque && white)
+	memcpy(dst, src, (b - a) * sizeof(uint32_t));
+      else
+	k->blit(dst, src, b - a, sp.color);
+    }
+    else
+      k->span(dst, b - a, sp);
+  }
+}
+
+
+void
+SoftRenderer::draw(const SpriteBatch& batch)
+{
+  draw(batch, screen);
+}
+
+
+void
+SoftRenderer::draw(const SpriteBatch& batch, const vector<DamageRect>& rects)
+{
+  drawCalls = 0;
+  vertices = 0;
+
+  for(size_t r = 0; r != rects.size(); ++r)
+  {
+    DamageRect clip = rects[r];
+    clip.w = std::min(clip.x + clip.w, w) - std::max(clip.x, 0);
+    clip.h = std::min(clip.y + clip.h, h) - std::max(clip.y, 0);
+    clip.x = std::max(clip.x, 0);
+    clip.y = std::max(clip.y, 0);
+    if(clip.w <= 0 || clip.h <= 0) continue;
+
+    for(size_t n = 0; n != batch.runs.size(); ++n)
+    {
+      const SpriteBatch::Run& run = batch.runs[n];
+      ++drawCalls;
+      vertices += run.count;
+      if(!run.tex || run.tex > textures.size()) continue;
+
+      const SoftTexture& tex = textures[run.tex - 1];
+      if(!tex.w) continue;	// released
+      for(size_t i = run.first; i != run.first + run.count; i += 4)
+	quad(&batch.verts[i], tex, clip);
+    }
+  }
+}
+
+
+void
+SoftRenderer::read(Image& img) const
+{
+  img.w = w;
+  img.h = h;
+  img.chans = 3;
+  img.px.resize(w * h * 3);
+  for(int y = 0; y != h; ++y)
+  {
+    const uint32_t* src = &fb[(h - 1 - y) * w];
+    unsigned char* dst = &img.px[y * w * 3];
+    for(int x = 0; x != w; ++x, dst += 3)
+    {
+      dst[0] = src[x] & 0xff;
+      dst[1] = (src[x] >> 8) & 0xff;
+      dst[2] = (src[x] >> 16) & 0xff;
+    }
+  }
+}
+
+
+bool
+loadSoftLevel(SoftRenderer& renderer, Level& data, const string& dataDir)
+{
+  vector<Asset> assets;
+  Decoder decoder;
+  return (decodeLevel(assets, data, dataDir, decoder)
+      || uploadSoftLevel(renderer, data, assets));
+}
+
+
+bool
+uploadSoftLevel(SoftRenderer& renderer, Level& data,
+    const vector<Asset>& assets)
+{
+  // background first
+  if(!assets.size()) return true;
+  for(size_t i = 0; i != assets.size(); ++i)
+    if(assets[i].failed) return true;
+
+  vector<Sprite*> sprites;
+  vector<string> files;
+  levelSprites(data, sprites, files);
+  vector<const Image*> imgs;
+  for(size_t i = 1; i != assets.size(); ++i)
+    imgs.push_back(&assets[i].img);
+
+  const Image& back = assets[0].img;
+  data.back.tex = renderer.upload(&back.px[0], back.w, back.h, back.chans,
+      back.w);
+  data.back.w = back.w;
+  data.back.h = back.h;
+  data.back.u0 = data.back.v0 = 0;
+  data.back.u1 = back.w;
+  data.back.v1 = back.h;
+
+  vector<Image> pages;
+  vector<AtlasRect> rects;
+  if(packAtlas(pages, rects, imgs, SoftRenderer::maxSize, atlasPad, false))
+    return true;
+  vector<Sprite> tex(pages.size());
+  for(size_t i = 0; i != pages.size(); ++i)
+  {
+    const Image& p = pages[i];
+    tex[i].tex = renderer.upload(&p.px[0], p.w, p.h, p.chans, p.w);
+    tex[i].w = p.w;
+    tex[i].h = p.h;
+    tex[i].u0 = tex[i].v0 = 0;
+    tex[i].u1 = p.w;
+    tex[i].v1 = p.h;
+  }
+  assignAtlas(sprites, tex, rects);
+  return false;
+}
+
+
+const char*
+softKernel()
+{
+  return select()->name;
+}
+
+
+bool
+setSoftKernel(const char* name)
+{
+  for(size_t i = 0; i != nKernels; ++i)
+  {
+    if(!strcmp(kernels[i].name, name))
+    {
+      if(!available(kernels[i])) return true;
+      selected = kernels + i;
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,100 @@
+/*
+ * regame: recycling game - software sprite renderer
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef soft_hh
+#define soft_hh
+
+/*
+ * Headers
+ */
+
+#include "batch.hh"
+#include "damage.hh"
+#include "image.hh"
+#include "loader.hh"
+
+#include <stdint.h>
+
+
+/*
+ * Structures
+ */
+
+// texel coordinates, like the rectangle textures of the GL path
+struct SoftTexture
+{
+  int w, h;
+  bool opaque;
+  vector<uint32_t> px;	// RGBA bytes, first row at v = 0
+};
+
+
+/*
+ * Draws a SpriteBatch into a framebuffer in memory, the same way the GL
+ * renderer does: every quad is an affine-mapped texture sampled bilinearly
+ * (clamped to the edge), modulated by the vertex color and blended by its
+ * alpha. Untransformed quads on whole pixels are copied or blended without
+ * filtering. The framebuffer has RGBA bytes with the bottom row first.
+ */
+
+class SoftRenderer
+{
+  vector<SoftTexture> textures;	// name - 1
+  vector<unsigned int> unused;	// released names
+  vector<DamageRect> screen;	// the whole framebuffer, as a clip
+
+  void quad(const Vertex* q, const SoftTexture& tex, const DamageRect& clip);
+
+public:
+  enum { maxSize = 8192 };
+
+  int w, h;
+  vector<uint32_t> fb;
+
+  // statistics of the last batch
+  int drawCalls;
+  int vertices;
+
+  SoftRenderer();
+
+  void resize(int w, int h);
+
+  // w x h pixels out of a tw-wide buffer: returns the texture name
+  unsigned int upload(const unsigned char* px, int w, int h, int chans,
+      int tw);
+
+  // free the pixels of a texture, leaving its name to reuse
+  void release(unsigned int name);
+
+  void draw(const SpriteBatch& batch);
+
+  // clipped to each rectangle
+  void draw(const SpriteBatch& batch, const vector<DamageRect>& rects);
+
+  // the framebuffer as an RGB image, top row first
+  void read(Image& img) const;
+};
+
+
+// the level's background and atlas from the data directory, without going
+// through FLTK: returns true on error
+bool
+loadSoftLevel(SoftRenderer& renderer, Level& data, const string& dataDir);
+
+// the same out of images already decoded by decodeLevel()
+bool
+uploadSoftLevel(SoftRenderer& renderer, Level& data,
+    const vector<Asset>& assets);
+
+// name of the selected blending kernel ("scalar", "sse2", "avx2")
+const char*
+softKernel();
+
+// force a kernel by name: returns true if unavailable
+bool
+setSoftKernel(const char* name);
+
+#endif
@@ -0,0 +1,284 @@
+/*
+ * regame: recycling game - batch difficulty sweeps
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "runner.hh"
+#include "timing.hh"
+
+#include <algorithm>
+
+#include <thread>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+
+/*
+ * Constants
+ */
+
+namespace
+{
+  const char gameData[] = "game.txt";
+}
+
+
+/*
+ * Utilities
+ */
+
+void
+usage(const char* prg)
+{
+  fprintf(stderr, "usage: %s [-d dir] [-l level] [-n games] [-t msecs] [-s step] [-j threads]\n"
+      "\t[-v key=v1,v2,...] [-a] [-o file] [-g file] [-S]\n"
+      "  -d dir\tgame data directory (.)\n"
+      "  -l level\tlevel number (0)\n"
+      "  -n games\tgames (seeds) per variant (1000)\n"
+      "  -t msecs\ttime limit per game (600000)\n"
+      "  -s step\tsimulation step in msecs (4)\n"
+      "  -j threads\tworker threads (one per core)\n"
+      "  -v key=...\tone level variant per value of the setting\n"
+      "  -a\t\tlet the autopilot play\n"
+      "  -o file\tsummary CSV (stdout)\n"
+      "  -g file\tper-game CSV\n"
+      "  -S\t\treport scaling at 1/2/4/8/N threads instead\n", prg);
+}
+
+
+// value at the p-th percentile of a sorted vector
+int
+percentile(const vector<int>& v, double p)
+{
+  return (v.size()? v[static_cast<size_t>(p / 100. * (v.size() - 1) + 0.5)]: 0);
+}
+
+
+double
+mean(const vector<int>& v)
+{
+  double sum = 0;
+  for(size_t i = 0; i != v.size(); ++i)
+    sum += v[i];
+  return (v.size()? sum / v.size(): 0);
+}
+
+
+void
+split(vector<string>& values, const string& list)
+{
+  size_t start = 0;
+  for(;;)
+  {
+    size_t end = list.find(',', start);
+    values.push_back(list.substr(start, end - start));
+    if(end == string::npos) break;
+    start = end + 1;
+  }
+}
+
+
+double
+timeRun(const Runner& runner, const vector<Level>& levels,
+    const vector<BatchJob>& jobs, vector<BatchResult>& results,
+    int step, int maxms, bool autopilot)
+{
+  double start = monotonic();
+  runner.run(levels, jobs, results, step, maxms, autopilot);
+  return monotonic() - start;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  string dataDir = ".";
+  int level = 0;
+  int games = 1000;
+  int maxms = 600000;
+  int step = 4;
+  int threads = 0;
+  string sweep;
+  const char* outFile = NULL;
+  const char* gamesFile = NULL;
+  bool scaling = false;
+  bool autopilot = false;
+
+  int c;
+  while((c = getopt(argc, argv, "d:l:n:t:s:j:v:ao:g:Sh")) != -1)
+  {
+    switch(c)
+    {
+    case 'd': dataDir = optarg; break;
+    case 'l': level = atoi(optarg); break;
+    case 'n': games = atoi(optarg); break;
+    case 't': maxms = atoi(optarg); break;
+    case 's': step = atoi(optarg); break;
+    case 'j': threads = atoi(optarg); break;
+    case 'v': sweep = optarg; break;
+    case 'a': autopilot = true; break;
+    case 'o': outFile = optarg; break;
+    case 'g': gamesFile = optarg; break;
+    case 'S': scaling = true; break;
+    default:
+      usage(argv[0]);
+      return (c == 'h'? EXIT_SUCCESS: EXIT_FAILURE);
+    }
+  }
+  if(games < 1 || maxms < 1 || step < 1 || threads < 0
+  || (sweep.size() && sweep.find('=') == string::npos))
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // level settings
+  string buf = dataDir + "/" + gameData;
+  string_map sm;
+  if(loadPairs(sm, buf.c_str()))
+  {
+    fprintf(stderr, "%s: cannot load game data from %s\n", argv[0], buf.c_str());
+    return EXIT_FAILURE;
+  }
+  string_map::const_iterator st = sm.find(numbered("level", level));
+  if(st == sm.end())
+  {
+    fprintf(stderr, "%s: no such level %d\n", argv[0], level);
+    return EXIT_FAILURE;
+  }
+  buf = dataDir + "/" + st->second;
+  string_map lsm;
+  if(loadPairs(lsm, buf.c_str()))
+  {
+    fprintf(stderr, "%s: cannot load level %d from %s\n", argv[0], level, buf.c_str());
+    return EXIT_FAILURE;
+  }
+
+  // one variant per value
+  string key;
+  vector<string> values;
+  if(sweep.size())
+  {
+    key = sweep.substr(0, sweep.find('='));
+    split(values, sweep.substr(key.size() + 1));
+  }
+  else
+    values.push_back("");
+
+  vector<Level> levels(values.size());
+  for(size_t v = 0; v != values.size(); ++v)
+  {
+    string_map vsm = lsm;
+    if(key.size()) vsm[key] = values[v];
+    if(loadLevel(levels[v], vsm) || loadSpriteSizes(levels[v], dataDir))
+    {
+      fprintf(stderr, "%s: cannot load level %d from %s\n", argv[0], level, buf.c_str());
+      return EXIT_FAILURE;
+    }
+    levels[v].name = st->second;
+  }
+
+  // the same seeds for every variant
+  vector<BatchJob> jobs(levels.size() * games);
+  for(size_t i = 0; i != jobs.size(); ++i)
+  {
+    jobs[i].level = i / games;
+    jobs[i].seed = i % games;
+  }
+  vector<BatchResult> results;
+
+  if(scaling)
+  {
+    int cores = std::thread::hardware_concurrency();
+    if(cores < 1) cores = 1;
+    vector<int> counts;
+    for(int t = 1; t <= 8; t *= 2)
+      counts.push_back(t);
+    if(std::find(counts.begin(), counts.end(), cores) == counts.end())
+      counts.push_back(cores);
+
+    double base = 0;
+    printf("threads,secs,games/s,speedup,efficiency\n");
+    for(size_t i = 0; i != counts.size(); ++i)
+    {
+      int t = counts[i];
+      double secs = timeRun(Runner(t), levels, jobs, results, step, maxms,
+	  autopilot);
+      if(!base) base = secs;
+      printf("%d,%.3f,%.1f,%.2f,%.2f\n", t, secs, jobs.size() / secs,
+	  base / secs, base / secs / t);
+      fflush(stdout);
+    }
+    return EXIT_SUCCESS;
+  }
+
+  Runner runner(threads);
+  double secs = timeRun(runner, levels, jobs, results, step, maxms,
+      autopilot);
+  long steps = 0;
+  for(size_t i = 0; i != results.size(); ++i)
+    steps += results[i].steps;
+  fprintf(stderr, "%d games, %d threads, %.3f s, %.1f games/s, %.0f steps/s\n",
+      static_cast<int>(jobs.size()), runner.size(), secs, jobs.size() / secs,
+      steps / secs);
+
+  if(gamesFile)
+  {
+    FILE* fd = fopen(gamesFile, "w");
+    if(!fd)
+    {
+      fprintf(stderr, "%s: cannot write %s\n", argv[0], gamesFile);
+      return EXIT_FAILURE;
+    }
+    fprintf(fd, "key,value,seed,over,survival_ms,score,pts\n");
+    for(size_t i = 0; i != jobs.size(); ++i)
+    {
+      const BatchResult& r = results[i];
+      fprintf(fd, "%s,%s,%u,%d,%d,%d,%d\n", key.c_str(),
+	  values[jobs[i].level].c_str(), jobs[i].seed, r.over, r.survival,
+	  r.score, r.pts);
+    }
+    fclose(fd);
+  }
+
+  // summary by variant
+  FILE* fd = (outFile? fopen(outFile, "w"): stdout);
+  if(!fd)
+  {
+    fprintf(stderr, "%s: cannot write %s\n", argv[0], outFile);
+    return EXIT_FAILURE;
+  }
+  fprintf(fd, "key,value,games,over,survival_mean,survival_p10,survival_p50,"
+      "survival_p90,score_mean,score_p10,score_p50,score_p90,score_max\n");
+  for(size_t v = 0; v != levels.size(); ++v)
+  {
+    vector<int> survival;
+    vector<int> score;
+    int over = 0;
+    for(int g = 0; g != games; ++g)
+    {
+      const BatchResult& r = results[v * games + g];
+      survival.push_back(r.survival);
+      score.push_back(r.score);
+      over += r.over;
+    }
+    std::sort(survival.begin(), survival.end());
+    std::sort(score.begin(), score.end());
+
+    fprintf(fd, "%s,%s,%d,%d,%.1f,%d,%d,%d,%.1f,%d,%d,%d,%d\n",
+	key.c_str(), values[v].c_str(), games, over,
+	mean(survival), percentile(survival, 10), percentile(survival, 50),
+	percentile(survival, 90), mean(score), percentile(score, 10),
+	percentile(score, 50), percentile(score, 90), score.back());
+  }
+  if(outFile) fclose(fd);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+/*
+ * regame: recycling game - lock-free thread hand-off
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef sync_hh
+#define sync_hh
+
+/*
+ * Headers
+ */
+
+#include <atomic>
+#include <stddef.h>
+
+
+/*
+ * Triple buffer: one writer keeps filling its own buffer and publishing it,
+ * one reader always gets the latest published one. Neither side ever waits;
+ * intermediate states the reader was too slow to see are simply skipped.
+ */
+
+template<class T>
+class TripleBuffer
+{
+  enum { fresh = 4 };
+
+  T buf[3];
+  std::atomic<unsigned int> middle;	// index, | fresh when unread
+  unsigned int back;			// writer's
+  unsigned int front;			// reader's
+
+public:
+  TripleBuffer()
+  : middle(1), back(0), front(2)
+  {}
+
+  // any of the three, only before sharing (to preallocate them)
+  T& buffer(int i)
+  { return buf[i]; }
+
+  // writer
+  T& write()
+  { return buf[back]; }
+
+  void publish()
+  { back = middle.exchange(back | fresh, std::memory_order_acq_rel) & 3; }
+
+  // reader: valid until the next read()
+  bool pending() const
+  { return middle.load(std::memory_order_acquire) & fresh; }
+
+  const T& read()
+  {
+    if(pending())
+      front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+    return buf[front];
+  }
+};
+
+
+/*
+ * Bounded single-producer/single-consumer queue: push and pop never block
+ * and fail instead when full/empty.
+ */
+
+template<class T, size_t N>
+class SpscQueue
+{
+  T buf[N];
+  alignas(64) std::atomic<size_t> head;	// next to pop
+  alignas(64) std::atomic<size_t> tail;	// next to push
+
+public:
+  SpscQueue()
+  : head(0), tail(0)
+  {}
+
+  bool push(const T& v)
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(t - head.load(std::memory_order_acquire) == N) return false;
+    buf[t % N] = v;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& v)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    if(h == tail.load(std::memory_order_acquire)) return false;
+    v = buf[h % N];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+};
+
+#endif
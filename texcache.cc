@@ -0,0 +1,138 @@
+/*
+ * regame: recycling game - texture cache
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "texcache.hh"
+
+#include <limits.h>
+#include <stdlib.h>
+
+
+/*
+ * Implementation
+ */
+
+TextureCache::TextureCache(Release destroy)
+: destroy(destroy), hits(0), misses(0), bytes(0)
+{}
+
+
+bool
+TextureCache::acquire(const string& key, Sprite& sprite)
+{
+  map<string, Entry>::iterator it = entries.find(key);
+  if(it == entries.end())
+  {
+    ++misses;
+    return true;
+  }
+
+  ++hits;
+  ++it->second.refs;
+  sprite = it->second.sprite;
+  return false;
+}
+
+
+void
+TextureCache::add(unsigned int tex, size_t bytes)
+{
+  Texture& t = textures[tex];
+  t.bytes = bytes;
+  t.sprites = 0;
+  this->bytes += bytes;
+}
+
+
+void
+TextureCache::insert(const string& key, Sprite& sprite)
+{
+  map<string, Entry>::iterator it = entries.find(key);
+  if(it != entries.end())
+  {
+    ++it->second.refs;
+    sprite = it->second.sprite;
+    return;
+  }
+
+  Entry& e = entries[key];
+  e.sprite = sprite;
+  e.refs = 1;
+
+  map<unsigned int, Texture>::iterator t = textures.find(sprite.tex);
+  if(t != textures.end()) ++t->second.sprites;
+}
+
+
+void
+TextureCache::release(const string& key)
+{
+  // gone already if the cache was cleared
+  map<string, Entry>::iterator it = entries.find(key);
+  if(it != entries.end() && it->second.refs > 0)
+    --it->second.refs;
+}
+
+
+void
+TextureCache::drop(unsigned int tex)
+{
+  map<unsigned int, Texture>::iterator t = textures.find(tex);
+  destroy(tex);
+  bytes -= t->second.bytes;
+  textures.erase(t);
+}
+
+
+void
+TextureCache::evict()
+{
+  for(map<string, Entry>::iterator it = entries.begin(); it != entries.end();)
+  {
+    if(it->second.refs)
+    {
+      ++it;
+      continue;
+    }
+
+    map<unsigned int, Texture>::iterator t = textures.find(it->second.sprite.tex);
+    if(t != textures.end()) --t->second.sprites;
+    entries.erase(it++);
+  }
+
+  for(map<unsigned int, Texture>::iterator t = textures.begin();
+      t != textures.end();)
+  {
+    map<unsigned int, Texture>::iterator cur = t++;
+    if(cur->second.sprites <= 0) drop(cur->first);
+  }
+}
+
+
+void
+TextureCache::clear()
+{
+  while(textures.size())
+    drop(textures.begin()->first);
+  entries.clear();
+}
+
+
+
+/*
+ * Utilities
+ */
+
+string
+textureKey(const string& file, bool alpha)
+{
+  char buf[PATH_MAX];
+  string key = (realpath(file.c_str(), buf)? buf: file.c_str());
+  return key + (alpha? "#rgba": "#rgb");
+}
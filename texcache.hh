@@ -0,0 +1,93 @@
+/*
+ * regame: recycling game - texture cache
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef texcache_hh
+#define texcache_hh
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+
+
+/*
+ * Sprites already uploaded, by key (see textureKey()), reference counted so
+ * that levels sharing images don't upload them again. Sprites sit in
+ * textures (atlas pages) of their own: a texture goes when none of its
+ * sprites is left. Unused sprites stay around until evict(), so that the
+ * next level can take them first.
+ */
+
+class TextureCache
+{
+public:
+  // deletes a texture
+  typedef void (*Release)(unsigned int tex);
+
+private:
+  struct Entry
+  {
+    Sprite sprite;
+    int refs;
+  };
+
+  struct Texture
+  {
+    size_t bytes;
+    int sprites;
+  };
+
+  Release destroy;
+  map<string, Entry> entries;
+  map<unsigned int, Texture> textures;
+
+  void drop(unsigned int tex);
+
+public:
+  // statistics
+  long hits;
+  long misses;
+  size_t bytes;		// resident
+
+  TextureCache(Release destroy);
+
+  // without taking it
+  bool cached(const string& key) const
+  { return entries.count(key); }
+
+  // fill the sprite if cached, taking a reference: returns true on a miss
+  bool acquire(const string& key, Sprite& sprite);
+
+  // a texture just uploaded, holding the sprites to insert()
+  void add(unsigned int tex, size_t bytes);
+
+  // a sprite out of an added texture, with a reference taken (if the key
+  // got inserted meanwhile, the sprite is set to that one instead)
+  void insert(const string& key, Sprite& sprite);
+
+  void release(const string& key);
+
+  // unused sprites, along with the textures left empty (or never used)
+  void evict();
+
+  // all textures, in use or not (the context is going away)
+  void clear();
+
+  int size() const
+  { return textures.size(); }
+};
+
+
+/*
+ * Utilities
+ */
+
+// the resolved path of an image file and how it's loaded
+string
+textureKey(const string& file, bool alpha);
+
+#endif
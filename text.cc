@@ -0,0 +1,51 @@
+/*
+ * regame: recycling game - batched text
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "text.hh"
+
+#include <math.h>
+#include <string.h>
+
+
+/*
+ * Implementation
+ */
+
+void
+TextLine::set(const GlyphFont& font, const char* str)
+{
+  if(this->font == &font && !strncmp(this->str, str, maxLen))
+    return;
+  this->font = &font;
+  strncpy(this->str, str, maxLen);
+  this->str[maxLen] = 0;
+
+  geom.clear();
+  geom.reserve(maxLen);
+  w = 0;
+  if(!font.glyphs.size()) return;
+  Point2f p(-font.pad, -font.descent - font.pad);
+  for(const char* c = this->str; *c; ++c)
+  {
+    int i = GlyphFont::index(*c);
+    if(i < 0) continue;
+    if(*c != ' ')
+      geom.add(font.glyphs[i], Affine::translate(floorf(w + 0.5f), 0), p);
+    w += font.advance[i];
+  }
+}
+
+
+void
+TextLine::draw(SpriteBatch& batch, float x, float y, const float color[3]) const
+{
+  batch.add(geom, floorf(x + 0.5f), floorf(y + 0.5f),
+      color[0], color[1], color[2], 1);
+}
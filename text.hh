@@ -0,0 +1,79 @@
+/*
+ * regame: recycling game - batched text
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef text_hh
+#define text_hh
+
+/*
+ * Headers
+ */
+
+#include "batch.hh"
+
+
+/*
+ * Bitmap font: the printable ASCII glyphs, rasterized once and drawn as
+ * sprites. Each glyph sprite is its advance wide plus pad on both sides, and
+ * the font's full height tall with the baseline at descent + pad.
+ */
+
+struct GlyphFont
+{
+  enum
+  {
+    first = ' ',
+    last = '~'
+  };
+
+  vector<Sprite> glyphs;
+  vector<float> advance;
+  int height;
+  int descent;
+  int pad;
+
+  GlyphFont()
+  : height(0), descent(0), pad(0)
+  {}
+
+  // index of c, -1 if not printable
+  static int index(char c)
+  { return (c >= first && c <= last? c - first: -1); }
+};
+
+
+/*
+ * One line of text laid out as white quads at the origin. The layout (and
+ * the width) is only rebuilt when the string changes: drawing copies the
+ * quads into the frame's batch, translated and tinted. Lines are cut at
+ * maxLen characters, so that changing them never allocates.
+ */
+
+class TextLine
+{
+public:
+  enum { maxLen = 127 };
+
+private:
+  const GlyphFont* font;
+  char str[maxLen + 1];
+  SpriteBatch geom;
+  float w;
+
+public:
+  TextLine()
+  : font(NULL), w(0)
+  { str[0] = 0; }
+
+  void set(const GlyphFont& font, const char* str);
+
+  float width() const
+  { return w; }
+
+  // starting at x with the baseline at y, snapped to whole pixels
+  void draw(SpriteBatch& batch, float x, float y, const float color[3]) const;
+};
+
+#endif
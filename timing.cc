@@ -0,0 +1,94 @@
+/*
+ * regame: recycling game - timing
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "timing.hh"
+
+#if (defined(__MINGW32__) && __GNUG__ > 3) || !defined(WIN32)
+#include <time.h>
+#include <errno.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+
+/*
+ * Implementation
+ */
+
+double
+monotonic()
+{
+#ifdef WIN32_LEAN_AND_MEAN
+  LARGE_INTEGER n;
+  LARGE_INTEGER freq;
+  QueryPerformanceCounter(&n);
+  QueryPerformanceFrequency(&freq);
+  return static_cast<double>(n.QuadPart) / freq.QuadPart;
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+
+void
+sleepUntil(double deadline)
+{
+#ifdef WIN32_LEAN_AND_MEAN
+  double left;
+  while((left = deadline - monotonic()) > 0)
+    Sleep(static_cast<DWORD>(left * 1e3));
+#else
+  if(deadline <= 0) return;
+  timespec ts;
+  ts.tv_sec = static_cast<time_t>(deadline);
+  ts.tv_nsec = static_cast<long>((deadline - ts.tv_sec) * 1e9);
+  if(ts.tv_nsec >= 1000000000) ts.tv_nsec = 999999999;
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#endif
+}
+
+
+FramePacer::FramePacer(double hz)
+{
+  reset(hz);
+}
+
+
+void
+FramePacer::reset(double hz)
+{
+  period = 1. / hz;
+  next = monotonic() + period;
+  missed = 0;
+}
+
+
+double
+FramePacer::remaining() const
+{
+  double left = next - monotonic();
+  return (left > 0? left: 0);
+}
+
+
+int
+FramePacer::wait()
+{
+  sleepUntil(next);
+
+  // whole periods past the deadline are lost: keep the phase
+  int late = static_cast<int>((monotonic() - next) / period);
+  next += (late + 1) * period;
+  missed += late;
+  return late;
+}
@@ -0,0 +1,52 @@
+/*
+ * regame: recycling game - timing
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef timing_hh
+#define timing_hh
+
+// monotonic high-resolution clock, in seconds
+double
+monotonic();
+
+// sleep until an absolute monotonic() time
+void
+sleepUntil(double deadline);
+
+
+/*
+ * Paces frames to absolute deadlines at a fixed rate: the phase doesn't drift
+ * with the latency of whoever wakes us up, and frames which can't make their
+ * deadline are skipped and counted instead of delaying all the following.
+ */
+
+class FramePacer
+{
+  double period;
+  double next;		// deadline of the next frame
+  long missed;
+
+public:
+  FramePacer(double hz = 60);
+
+  // restart from now
+  void reset(double hz);
+
+  double rate() const
+  { return 1. / period; }
+
+  // secs until the next deadline (0 if already due)
+  double remaining() const;
+
+  // sleep until the next deadline and move past it: returns the frames
+  // missed since the previous one
+  int wait();
+
+  // in total
+  long skipped() const
+  { return missed; }
+};
+
+#endif
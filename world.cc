@@ -0,0 +1,583 @@
+/*
+ * regame: recycling game - game state/simulation
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+/*
+ * Headers
+ */
+
+#include "world.hh"
+#include "integrate.hh"
+
+#include <fstream>
+using std::ifstream;
+
+#include <algorithm>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+
+
+/*
+ * Constants
+ */
+
+namespace
+{
+  // container keys: cntKey, index, field suffix
+  const char cntKey[] = "cnt";
+  const size_t cntKeyLen = sizeof(cntKey) - 1;
+
+  enum CntField
+  {
+    cntAccept, cntX, cntY, cntAX1, cntAY1, cntAX2, cntAY2
+  };
+
+  const struct
+  {
+    const char* suffix;
+    CntField field;
+  } cntFields[] =
+  {
+    {"t", cntAccept},
+    {"x", cntX},
+    {"y", cntY},
+    {"ax1", cntAX1},
+    {"ay1", cntAY1},
+    {"ax2", cntAX2},
+    {"ay2", cntAY2}
+  };
+}
+
+
+
+/*
+ * Utilities
+ */
+
+float
+defaultValue(const string_map& settings,
+    const string& setting, const float def)
+{
+  string_map::const_iterator st = settings.find(setting);
+  return (st == settings.end()? def: atof(st->second.c_str()));
+}
+
+
+string
+defaultValue(const string_map& settings,
+    const string& setting, const string& def)
+{
+  string_map::const_iterator st = settings.find(setting);
+  return (st == settings.end()? def: st->second);
+}
+
+
+bool
+loadPairs(string_map& buf, const char* file)
+{
+  ifstream in(file);
+  if(!in) return true;
+
+  string line;
+  while(std::getline(in, line))
+  {
+    // empty lines
+    if(!line.size())
+      continue;
+    if(line[0] == '#')
+      continue;
+
+    string::size_type eq = line.find('=');
+    if(eq == string::npos || eq == 0)
+      return true;
+
+    // insert the new element
+    buf.insert(make_pair(line.substr(0, eq), line.substr(eq + 1)));
+  }
+
+  return false;
+}
+
+
+float*
+parseColor(float* buf, const char* color)
+{
+  // parse the value
+  unsigned long v = strtoul((color[0] == '#'? color + 1: color), NULL, 16);
+
+  // separate the components
+  buf[0] = static_cast<float>((v >> 16) & 0xFF) / 255.;
+  buf[1] = static_cast<float>((v >> 8) & 0xFF) / 255.;
+  buf[2] = static_cast<float>((v) & 0xFF) / 255.;
+
+  return buf;
+}
+
+
+string
+numbered(const string& prefix, int i)
+{
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%d", i);
+  return prefix + buf;
+}
+
+
+string
+spritePath(const string& dataDir, const string& prefix, int i)
+{
+  string buf = dataDir;
+  if(buf.size()) buf += "/";
+  buf += numbered(prefix, i);
+  buf += ".png";
+  return buf;
+}
+
+
+string
+backFile(const Level& data)
+{
+  return data.backPrefix + ".png";
+}
+
+
+void
+levelSprites(Level& data, vector<Sprite*>& sprites, vector<string>& files)
+{
+  // player
+  for(size_t i = 0; i != data.playerAnim.size(); ++i)
+  {
+    sprites.push_back(&data.playerAnim[i]);
+    files.push_back(spritePath("", data.playerPrefix, i));
+  }
+
+  // containers
+  for(size_t i = 0; i != data.cnts.size(); ++i)
+  {
+    sprites.push_back(&data.cnts[i].s);
+    files.push_back(spritePath("", data.cntsPrefix, i));
+  }
+
+  // objects
+  for(size_t i = 0; i != data.objs.size(); ++i)
+  {
+    sprites.push_back(&data.objs[i]);
+    files.push_back(spritePath("", data.objsPrefix, i));
+  }
+}
+
+
+bool
+loadLevel(Level& data, const char* file)
+{
+  string_map sm(data.arena());
+  return (loadPairs(sm, file) || loadLevel(data, sm));
+}
+
+
+bool
+loadLevel(Level& data, const string_map& sm)
+{
+  data.title = defaultValue(sm, "title", "title");
+  data.grav = defaultValue(sm, "grav", 0.001);
+  data.maxFallSpeed = defaultValue(sm, "maxFallSpeed", 0.2);
+  data.minSpeed = defaultValue(sm, "minSpeed", 0.2);
+  data.maxPlayerSpeed = defaultValue(sm, "maxPlayerSpeed", 0.3);
+  data.playerAccel = defaultValue(sm, "playerAccel", 0.001);
+  parseColor(data.color, defaultValue(sm, "color", "#FF0000").c_str());
+  data.w = defaultValue(sm, "w", 640);
+  data.h = defaultValue(sm, "h", 480);
+  data.mms = defaultValue(sm, "mms", 3000);
+  data.mmd = defaultValue(sm, "mmd", 2000);
+  data.player.y = defaultValue(sm, "y", 40);
+  data.baseline = defaultValue(sm, "baseline", 10);
+  data.topline = defaultValue(sm, "topline", 300);
+  data.backPrefix = defaultValue(sm, "back", "back");
+  data.cntsPrefix = defaultValue(sm, "cntsPrefix", "cnts");
+  data.objsPrefix = defaultValue(sm, "objsPrefix", "objs");
+  data.playerPrefix = defaultValue(sm, "plyrPrefix", "plyr");
+  data.playerAnim.resize(defaultValue(sm, "plyrs", 1));
+  data.playerFpms = defaultValue(sm, "plyrFpms", 80.);
+  data.shakeLen = defaultValue(sm, "shakeLen", 100);
+  data.shake = defaultValue(sm, "shake", 10);
+  data.fallWin[0] = defaultValue(sm, "fallx1", 20);
+  data.fallWin[1] = defaultValue(sm, "fallx2", 600);
+
+  int n = defaultValue(sm, "cnts", 3);
+  data.cnts.resize(n);
+  data.objs.resize(n);
+  for(int i = 0; i != n; ++i)
+  {
+    Container& ct = data.cnts[i];
+    ct.accept = i;
+    ct.pos.x = ct.pos.y = 0;
+    ct.accWin[0].x = ct.accWin[0].y = 0;
+    ct.accWin[1].x = ct.accWin[1].y = 0;
+  }
+
+  // container settings ("cnt12ax1") are contiguous in the map: parse them in
+  // one pass instead of building and looking up every key of every container
+  for(string_map::const_iterator it = sm.lower_bound(cntKey);
+      it != sm.end() && !it->first.compare(0, cntKeyLen, cntKey); ++it)
+  {
+    const char* key = it->first.c_str() + cntKeyLen;
+    // a plain decimal index: no signs, spaces or leading zeros, which
+    // strtol() would take ("cnt+1x", "cnt 1x" and "cnt01x" aren't "cnt1x")
+    const char* end = key;
+    long i = 0;
+    while(isdigit(static_cast<unsigned char>(*end)) && i < n)
+      i = i * 10 + (*end++ - '0');
+    if(end == key || (*key == '0' && end - key > 1) || i >= n) continue;
+
+    for(size_t f = 0; f != sizeof(cntFields) / sizeof(*cntFields); ++f)
+    {
+      if(strcmp(end, cntFields[f].suffix)) continue;
+
+      Container& ct = data.cnts[i];
+      float v = atof(it->second.c_str());
+      switch(cntFields[f].field)
+      {
+      case cntAccept: ct.accept = static_cast<ObjType>(v); break;
+      case cntX: ct.pos.x = v; break;
+      case cntY: ct.pos.y = v; break;
+      case cntAX1: ct.accWin[0].x = v; break;
+      case cntAY1: ct.accWin[0].y = v; break;
+      case cntAX2: ct.accWin[1].x = v; break;
+      case cntAY2: ct.accWin[1].y = v; break;
+      }
+      break;
+    }
+  }
+  data.acceptIndex.build(data.cnts);
+
+  return false;
+}
+
+
+bool
+pngSize(Sprite& sprite, const char* file)
+{
+  FILE* fd = fopen(file, "rb");
+  if(!fd) return true;
+
+  // signature, IHDR length/type, then big-endian width and height
+  unsigned char buf[24];
+  bool ret = (fread(buf, sizeof(buf), 1, fd) != 1
+      || buf[1] != 'P' || buf[2] != 'N' || buf[3] != 'G'
+      || buf[12] != 'I' || buf[13] != 'H' || buf[14] != 'D' || buf[15] != 'R');
+  fclose(fd);
+  if(ret) return true;
+
+  sprite.w = (buf[16] << 24) | (buf[17] << 16) | (buf[18] << 8) | buf[19];
+  sprite.h = (buf[20] << 24) | (buf[21] << 16) | (buf[22] << 8) | buf[23];
+  return false;
+}
+
+
+bool
+loadSpriteSizes(Level& data, const string& dataDir)
+{
+  // the simulation only needs the geometry: just peek at the PNG headers
+  bool ret = pngSize(data.back, (dataDir + "/" + backFile(data)).c_str());
+
+  vector<Sprite*> sprites;
+  vector<string> files;
+  levelSprites(data, sprites, files);
+  for(size_t i = 0; i != sprites.size(); ++i)
+    ret |= pngSize(*sprites[i], (dataDir + "/" + files[i]).c_str());
+  return ret;
+}
+
+
+
+
+size_t
+particleCapacity(const Level& data, int step)
+{
+  // once mms runs out (as it does after a game over) a particle is spawned
+  // on every step; none lives longer than falling all the way at the
+  // slowest speed it can get, plus accelerating and bouncing at the fastest
+  int objH = 0;
+  for(size_t i = 0; i != data.objs.size(); ++i)
+    objH = std::max(objH, data.objs[i].h);
+  float slowest = std::min(data.maxFallSpeed / 5, data.minSpeed / 2);
+  float fastest = data.maxFallSpeed * 6 / 5;
+  if(slowest <= 0 || data.grav <= 0)
+    return 0;			// might bounce forever
+  double life = (data.h + 2 * objH) / slowest + 6 * fastest / data.grav;
+
+  // and the one held by the player
+  return static_cast<size_t>(life / step) + 2;
+}
+
+
+/*
+ * Implementation
+ */
+
+void
+AcceptIndex::build(const ContainerTable& cnts)
+{
+  // bucket by type, as a counting sort
+  int types = 0;
+  for(size_t i = 0; i != cnts.size(); ++i)
+    if(cnts[i].accept >= types) types = cnts[i].accept + 1;
+
+  typeStart.assign(types + 1, 0);
+  for(size_t i = 0; i != cnts.size(); ++i)
+    if(cnts[i].accept >= 0) ++typeStart[cnts[i].accept + 1];
+  for(int t = 1; t <= types; ++t)
+    typeStart[t] += typeStart[t - 1];
+
+  entries.resize(typeStart[types]);
+  vector<size_t> next(typeStart.begin(), typeStart.end() - 1);
+  for(size_t i = 0; i != cnts.size(); ++i)
+  {
+    const Container& ct = cnts[i];
+    if(ct.accept < 0) continue;
+
+    Entry& e = entries[next[ct.accept]++];
+    e.left = ct.pos.x + ct.accWin[0].x;
+    e.right = ct.pos.x + ct.accWin[1].x;
+    e.bottom = ct.pos.y + ct.accWin[0].y;
+    e.cnt = i;
+  }
+
+  for(int t = 0; t != types; ++t)
+  {
+    Entries::iterator b = entries.begin() + typeStart[t];
+    Entries::iterator e = entries.begin() + typeStart[t + 1];
+    std::sort(b, e, byLeft);
+    for(Entries::iterator it = b; it != e; ++it)
+      it->maxRight = (it == b || it->right > (it - 1)->maxRight?
+	  it->right: (it - 1)->maxRight);
+  }
+}
+
+
+int
+AcceptIndex::find(ObjType t, float x, float y) const
+{
+  if(t < 0 || static_cast<size_t>(t) + 1 >= typeStart.size()
+  || typeStart[t] == typeStart[t + 1])
+    return -1;
+
+  // only windows starting left of x are candidates; walk them right to left
+  // until no window can extend past x anymore
+  const Entry* b = &entries[typeStart[t]];
+  const Entry* e = std::lower_bound(b, &entries[0] + typeStart[t + 1], x,
+      leftOf);
+  int found = -1;
+  while(e != b && (--e)->maxRight > x)
+  {
+    if(x < e->right && y > e->bottom && (found < 0 || e->cnt < found))
+      found = e->cnt;
+  }
+  return found;
+}
+
+
+
+namespace
+{
+  const int startLives = 3;
+}
+
+
+World::World(const Level& data)
+: data(data)
+{
+  reset();
+}
+
+
+void
+World::reset()
+{
+  particles.clear();
+  started = false;
+  grabbed = false;
+  startms = 0;
+  lives = startLives;
+  pts = 0;
+  mms = data.mms;
+  mmd = data.mmd;
+  data.player.x = data.w / 2;
+  data.player.sx = 0;
+  prevX = data.player.x;
+  toNext = 0;
+  score = 0;
+  for(size_t i = 0; i != data.cnts.size(); ++i)
+    data.cnts[i].shakeStart = -data.shakeLen - 1;
+}
+
+
+void
+World::start()
+{
+  startms = 0;
+  started = true;
+}
+
+
+void
+World::gameover()
+{
+  score = points();
+
+  // some fun
+  mms = mmd = 100;
+  toNext = 0;
+}
+
+
+void
+World::release()
+{
+  if(!grabbed) return;
+  grabbed = false;
+
+  // reinject the particle
+  particles.add(data.player.x, data.player.y + data.playerAnim[0].h / 2,
+      data.maxFallSpeed, grabType, true, data.maxFallSpeed / 2, rand());
+}
+
+
+void
+World::spawn(int y)
+{
+  ObjType type = rand() % data.cnts.size();
+  float x = data.fallWin[0] + rand() % (data.fallWin[1] - data.fallWin[0]);
+  if(y < 0) y = data.h + data.objs[type].h;
+  float maxSpeed = (rand() + Random::max / 5.) / Random::max * data.maxFallSpeed;
+  particles.add(x, y, 0, type, false, maxSpeed, rand());
+}
+
+
+void
+World::fill(int n)
+{
+  particles.reserve(particles.size() + n);
+  for(int i = 0; i != n; ++i)
+    spawn(data.baseline + rand() % (data.h - data.baseline));
+}
+
+
+bool
+World::update(int delta, Dir dir)
+{
+  bool over = false;
+  startms += delta;
+
+  // keep the previous state around for drawing in-between steps
+  prevX = data.player.x;
+  particles.prevY = particles.y;
+
+  if(dir == dirLeft)
+  {
+    data.player.sx -= data.playerAccel * delta;
+    if(data.player.sx < -data.maxPlayerSpeed)
+      data.player.sx = -data.maxPlayerSpeed;
+  }
+  else if(dir == dirRight)
+  {
+    data.player.sx += data.playerAccel * delta;
+    if(data.player.sx > data.maxPlayerSpeed)
+      data.player.sx = data.maxPlayerSpeed;
+  }
+  else if(data.player.sx)
+  {
+    float d = copysign(1, data.player.sx) * data.playerAccel * delta;
+    if(fabs(d) > fabs(data.player.sx))
+      data.player.sx = 0;
+    else
+      data.player.sx -= d;
+  }
+
+  data.player.x += delta * data.player.sx;
+  if(data.player.x < 0) { data.player.x = 0; data.player.sx = 0; }
+  if(data.player.x > data.w) { data.player.x = data.w; data.player.sx = 0; }
+
+  // new particles
+  int immd = static_cast<int>(mmd);
+  if(immd > 0 && (toNext -= delta) < 0)
+  {
+    toNext += mms + rand() % immd;
+    spawn();
+  }
+
+  // recalculate positions: bounces can be done up-front only when the
+  // particle cannot be grabbed instead
+  ParticlePool& p = particles;
+  if(p.size())
+  {
+    IntegrateParams ip;
+    ip.delta = delta;
+    ip.grav = data.grav * delta;
+    ip.topline = data.topline;
+    ip.bounceTop = (data.baseline <= data.player.y? data.baseline: -HUGE_VALF);
+    ip.baseline = data.baseline;
+    ip.minSpeed = data.minSpeed;
+    integrate(&p.y[0], &p.sy[0], &p.maxSpeed[0], &p.grabbed[0], p.size(), ip);
+  }
+
+  // grab/lose/accept
+  const float grabTop = data.player.y + data.playerAnim[0].h;
+  for(size_t i = 0; i != p.size();)
+  {
+    if(!p.grabbed[i] && p.y[i] < grabTop)
+    {
+      if(!grabbed && p.y[i] > data.player.y && labs(p.x[i] - data.player.x) < data.playerAnim[0].w / 2)
+      {
+	grabbed = true;
+	grabType = p.type[i];
+	p.remove(i);
+	continue;
+      }
+      else if(p.y[i] < data.baseline)
+      {
+	if(p.maxSpeed[i] > data.minSpeed)
+	{
+	  p.y[i] = data.baseline;
+	  p.sy[i] = p.maxSpeed[i];
+	  p.maxSpeed[i] /= 2;
+	}
+	else if(p.y[i] < -data.objs[p.type[i]].h)
+	{
+	  if(!--lives)
+	  {
+	    gameover();
+	    over = true;
+	  }
+	  p.remove(i);
+	  continue;
+	}
+      }
+    }
+
+    if(p.grabbed[i])
+    {
+      int ct = data.acceptIndex.find(p.type[i], p.x[i], p.y[i]);
+      if(ct >= 0)
+      {
+	++pts;
+	p.remove(i);
+	data.cnts[ct].shakeStart = startms;
+	continue;
+      }
+    }
+
+    ++i;
+  }
+
+  mms -= delta / 100.;
+  mmd -= delta / 1000.;
+
+  return over;
+}
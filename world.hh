@@ -0,0 +1,305 @@
+/*
+ * regame: recycling game - game state/simulation
+ * Copyright(c) 2003 by wave++ "Yuri D'Elia" <wavexx@thregr.org>
+ * Distributed under GNU LGPL WITHOUT ANY WARRANTY.
+ */
+
+#ifndef world_hh
+#define world_hh
+
+/*
+ * Headers
+ */
+
+#include "pool.hh"
+#include "arena.hh"
+
+#include <vector>
+using std::vector;
+
+#include <string>
+using std::string;
+
+#include <map>
+using std::map;
+
+
+/*
+ * Structures
+ */
+
+typedef map<string, string, std::less<string>,
+    ArenaAllocator<std::pair<const string, string> > > string_map;
+
+struct Point2f
+{
+  Point2f()
+  {}
+
+  Point2f(float x, float y)
+  : x(x), y(y)
+  {}
+
+  float x;
+  float y;
+};
+
+
+// the texture name is a GLuint, but we don't want GL here. Texture
+// coordinates are normalized or in texels depending on the texture target.
+struct Sprite
+{
+  unsigned int tex;
+  int w, h;
+  float u0, v0;
+  float u1, v1;
+};
+
+
+struct PointAcc2f: public Point2f
+{
+  PointAcc2f()
+  {}
+
+  PointAcc2f(float x, float y, float sx, float sy)
+  : Point2f(x, y), sx(sx), sy(sy)
+  {}
+
+  float sx;
+  float sy;
+};
+
+
+struct Container
+{
+  ObjType accept;
+  Point2f pos;
+  Sprite s;
+  Point2f accWin[2];
+  int shakeStart;
+};
+
+
+// level tables
+typedef vector<Container, ArenaAllocator<Container> > ContainerTable;
+typedef vector<Sprite, ArenaAllocator<Sprite> > SpriteTable;
+
+
+/*
+ * Containers by accepted type, each bucket sorted by the left edge of the
+ * acceptance window: finding the container catching a thrown object is a
+ * binary search in its bucket instead of a scan of the whole level.
+ */
+
+class AcceptIndex
+{
+  struct Entry
+  {
+    float left, right;	// acceptance window
+    float bottom;
+    float maxRight;	// running maximum of right within the bucket
+    int cnt;		// container index
+  };
+
+  static bool leftOf(const Entry& e, float x)
+  { return e.left < x; }
+
+  static bool byLeft(const Entry& a, const Entry& b)
+  { return a.left < b.left; }
+
+  typedef vector<Entry, ArenaAllocator<Entry> > Entries;
+
+  vector<size_t, ArenaAllocator<size_t> > typeStart;
+  Entries entries;
+
+public:
+  AcceptIndex(Arena* arena = NULL)
+  : typeStart(arena), entries(arena)
+  {}
+
+  void build(const ContainerTable& cnts);
+
+  // first container (in level order) accepting type t at x, y: -1 if none
+  int find(ObjType t, float x, float y) const;
+};
+
+
+// the tables live in the arena, if any: copies don't
+struct Level
+{
+  // physics (pixels/msec)
+  float grav;
+  float maxFallSpeed;
+  float maxPlayerSpeed;
+  float playerAccel;
+  float playerFpms;
+  float minSpeed;
+
+  // general params
+  string name;		// level file, as named in the game data
+  string title;
+  int w, h;
+  float mms;
+  float mmd;
+  int baseline;
+  int topline;
+  float color[3];
+  int shakeLen;
+  int shake;
+  int fallWin[2];
+
+  // texture paths
+  string backPrefix;
+  string cntsPrefix;
+  string objsPrefix;
+  string playerPrefix;
+
+  // objects
+  Sprite back;
+  PointAcc2f player;
+  ContainerTable cnts;
+  AcceptIndex acceptIndex;	// rebuild when cnts change
+  SpriteTable playerAnim;
+  SpriteTable objs;
+
+  Level(Arena* arena = NULL)
+  : cnts(arena), acceptIndex(arena), playerAnim(arena), objs(arena)
+  {}
+
+  // as the tables have it, so that a copy never points to another level's
+  Arena* arena() const
+  { return cnts.get_allocator().arena; }
+};
+
+
+// player input
+enum Dir
+{
+  dirNone = 0,
+  dirLeft,
+  dirRight
+};
+
+
+/*
+ * Game state: everything needed to step a level, without any GUI
+ */
+
+// small deterministic generator (xorshift), so that each world can be
+// reproduced from its seed on any platform
+class Random
+{
+  unsigned int s;
+
+public:
+  enum { max = 0x7fffffff };
+
+  Random(unsigned int seed = 0)
+  { this->seed(seed); }
+
+  void seed(unsigned int seed)
+  { s = seed * 2654435761U + 0x9e3779b9U; if(!s) s = 1; }
+
+  // uniform in [0, max]
+  int operator()()
+  {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s & max;
+  }
+};
+
+
+class World
+{
+  void gameover();
+  void spawn(int y = -1);
+
+public:
+  Level data;
+  Random rand;
+
+  // game state
+  bool started;
+  int startms;
+  int score;
+  int lives;
+  float mms;
+  float mmd;
+  int pts;
+
+  // objects
+  ParticlePool particles;
+  bool grabbed;
+  int grabType;
+  int toNext;
+
+  // player position before the last step (interpolation)
+  float prevX;
+
+  World(const Level& data);
+
+  void reset();
+  void seed(unsigned int s)
+  { rand.seed(s); }
+  void start();
+  void release();
+
+  // score if the game ended now
+  int points() const
+  { return startms / 1000 + pts * 100; }
+
+  // populate with n particles at random heights (benchmarking)
+  void fill(int n);
+  // step the world by delta msecs: returns true when the game ends
+  bool update(int delta, Dir dir);
+};
+
+
+/*
+ * Utilities
+ */
+
+float
+defaultValue(const string_map& settings,
+    const string& setting, const float def);
+
+string
+defaultValue(const string_map& settings,
+    const string& setting, const string& def);
+
+bool
+loadPairs(string_map& buf, const char* file);
+
+float*
+parseColor(float* buf, const char* color);
+
+// prefix followed by i in decimal ("level12")
+string
+numbered(const string& prefix, int i);
+
+string
+spritePath(const string& dataDir, const string& prefix, int i);
+
+// background file and alpha sprites, in atlas order
+string
+backFile(const Level& data);
+
+void
+levelSprites(Level& data, vector<Sprite*>& sprites, vector<string>& files);
+
+bool
+loadLevel(Level& data, const string_map& sm);
+
+bool
+loadLevel(Level& data, const char* file);
+
+bool
+loadSpriteSizes(Level& data, const string& dataDir);
+
+// most particles alive at once in the level, stepped by step msecs
+size_t
+particleCapacity(const Level& data, int step);
+
+#endif